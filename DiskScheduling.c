@@ -3,211 +3,1474 @@
 #include <limits.h> // For INT_MAX
 #include <string.h> // For memcpy() and strcmp()
 #include <math.h>   // For abs()
+#include <time.h>   // For clock_gettime()
+#include <unistd.h> // For getopt()
+#include <stdint.h>
+#include <pthread.h>
 
-// A helper function for qsort()
-int compare(const void *a, const void *b) {
-    return (*(int *)a - *(int *)b);
+// Print a message and stop - used when malloc fails or input is bad
+void die(const char *msg) {
+    fprintf(stderr, "disksim: %s\n", msg);
+    exit(1);
+}
+
+void *xmalloc(size_t size) {
+    void *p = malloc(size ? size : 1);
+    if (p == NULL) die("out of memory");
+    return p;
 }
 
 // ----------------------------------------------------------------
-// 1. SSTF: Shortest Seek Time First
+// Sorting requests by cylinder: LSD radix sort
 // ----------------------------------------------------------------
-void sstf(int requests[], int n, int head) {
-    // Create a copy of requests to avoid modifying the original
-    int req_copy[n];
-    memcpy(req_copy, requests, n * sizeof(int));
 
-    int total_seek = 0;
-    int serviced_count = 0;
-    int current_pos = head;
+// Cylinders (and LBAs) are bounded integers, so instead of qsort - an
+// indirect call per comparison - we sort them a byte at a time, lowest
+// byte first. Each pass is one counting pass and one stable scatter,
+// and a pass is skipped when every key has the same byte there (the top
+// bytes of small cylinder numbers), so sorting n requests is a few
+// linear sweeps. Signed keys get their sign bit flipped so negative
+// numbers sort first.
+//
+// The sort is stable, so requests built in requests[] order come out
+// by (cylinder, index), the same order compare_request() gives.
 
-    // We'll use an array to mark which requests are done
-    // 0 = not serviced, 1 = serviced
-    int serviced[n];
-    for (int i = 0; i < n; i++) {
-        serviced[i] = 0;
+#define RADIX_BITS 8
+#define RADIX_SIZE (1 << RADIX_BITS)
+
+// Below this many keys the parallel sort just runs the serial one
+#define RADIX_PARALLEL_MIN (1 << 16)
+
+struct Request {
+    int cylinder;
+    int index;      // position in the original requests[]
+};
+
+// Sort by cylinder, then by position in requests[]
+int compare_request(const void *a, const void *b) {
+    const struct Request *x = a, *y = b;
+    if (x->cylinder != y->cylinder) return x->cylinder < y->cylinder ? -1 : 1;
+    return (x->index > y->index) - (x->index < y->index);
+}
+
+static inline uint32_t request_key(const struct Request *r) {
+    return (uint32_t)r->cylinder ^ 0x80000000u;
+}
+
+// Turns the counts of one pass into starting offsets. Returns 0 when
+// all n keys share one digit, so the pass would not move anything.
+static int radix_offsets(size_t *count, size_t n) {
+    size_t sum = 0;
+    for (int d = 0; d < RADIX_SIZE; d++) {
+        if (count[d] == n) return 0;
+        size_t c = count[d];
+        count[d] = sum;
+        sum += c;
+    }
+    return 1;
+}
+
+// Sort a[] by cylinder, using tmp[] (also n long) as scratch
+void radix_sort_requests(struct Request *a, struct Request *tmp, size_t n) {
+    enum { PASSES = 32 / RADIX_BITS };
+    size_t count[PASSES][RADIX_SIZE] = {{0}};
+    // One read of the input counts the digits for every pass
+    for (size_t i = 0; i < n; i++) {
+        uint32_t k = request_key(&a[i]);
+        for (int p = 0; p < PASSES; p++) count[p][(k >> (p * RADIX_BITS)) & (RADIX_SIZE - 1)]++;
+    }
+
+    struct Request *src = a, *dst = tmp;
+    for (int p = 0; p < PASSES; p++) {
+        if (!radix_offsets(count[p], n)) continue;
+        int shift = p * RADIX_BITS;
+        for (size_t i = 0; i < n; i++) {
+            dst[count[p][(request_key(&src[i]) >> shift) & (RADIX_SIZE - 1)]++] = src[i];
+        }
+        struct Request *t = src;
+        src = dst;
+        dst = t;
+    }
+    if (src != a) memcpy(a, src, n * sizeof(struct Request));
+}
+
+// Sort 64-bit signed keys, using tmp[] (also n long) as scratch
+void radix_sort_ll(long long *a, long long *tmp, size_t n) {
+    enum { PASSES = 64 / RADIX_BITS };
+    size_t count[PASSES][RADIX_SIZE] = {{0}};
+    for (size_t i = 0; i < n; i++) {
+        uint64_t k = (uint64_t)a[i] ^ 0x8000000000000000ull;
+        for (int p = 0; p < PASSES; p++) count[p][(k >> (p * RADIX_BITS)) & (RADIX_SIZE - 1)]++;
     }
 
-    printf("SSTF Path: %d", current_pos);
+    long long *src = a, *dst = tmp;
+    for (int p = 0; p < PASSES; p++) {
+        if (!radix_offsets(count[p], n)) continue;
+        int shift = p * RADIX_BITS;
+        for (size_t i = 0; i < n; i++) {
+            uint64_t k = (uint64_t)src[i] ^ 0x8000000000000000ull;
+            dst[count[p][(k >> shift) & (RADIX_SIZE - 1)]++] = src[i];
+        }
+        long long *t = src;
+        src = dst;
+        dst = t;
+    }
+    if (src != a) memcpy(a, src, n * sizeof(long long));
+}
+
+// --- Parallel radix sort ---
+// Every thread owns one slice of the input. In each pass the threads
+// count the digits of their slice, meet at a barrier, and work out
+// where their keys go: digit d of thread t starts after every smaller
+// digit, and after digit d of threads 0..t-1. That keeps the sort
+// stable, and the threads then scatter their slices without locks.
 
-    // Loop until all requests are serviced
-    while (serviced_count < n) {
-        int min_distance = INT_MAX;
-        int index = -1;
+struct RadixSort {
+    struct Request *a, *tmp;
+    size_t n;
+    int threads;
+    size_t (*count)[RADIX_SIZE];    // count[t][d], per thread
+    pthread_barrier_t barrier;
+    struct Request *result;         // a or tmp, whichever holds the output
+};
 
-        // Find the closest un-serviced request
-        for (int i = 0; i < n; i++) {
-            if (serviced[i] == 0) {
-                int distance = abs(current_pos - req_copy[i]);
-                if (distance < min_distance) {
-                    min_distance = distance;
-                    index = i;
-                }
+struct RadixThread {
+    struct RadixSort *r;
+    int id;
+};
+
+static void *radix_worker(void *param) {
+    struct RadixThread *th = param;
+    struct RadixSort *r = th->r;
+    size_t first = r->n * th->id / r->threads;
+    size_t last = r->n * (th->id + 1) / r->threads;
+    size_t *mine = r->count[th->id];
+    size_t offset[RADIX_SIZE];
+
+    struct Request *src = r->a, *dst = r->tmp;
+    for (int shift = 0; shift < 32; shift += RADIX_BITS) {
+        memset(mine, 0, RADIX_SIZE * sizeof(size_t));
+        for (size_t i = first; i < last; i++) mine[(request_key(&src[i]) >> shift) & (RADIX_SIZE - 1)]++;
+        pthread_barrier_wait(&r->barrier);
+
+        // Every thread sees the same totals, so they all agree on a skip
+        int skip = 0;
+        size_t sum = 0;
+        for (int d = 0; d < RADIX_SIZE; d++) {
+            size_t total = 0, before = 0;
+            for (int t = 0; t < r->threads; t++) {
+                if (t == th->id) before = total;
+                total += r->count[t][d];
             }
+            if (total == r->n) skip = 1;
+            offset[d] = sum + before;
+            sum += total;
         }
+        // Nobody may overwrite its counts until everyone has read them
+        pthread_barrier_wait(&r->barrier);
+        if (skip) continue;
 
-        // Service the closest request
-        if (index != -1) {
-            total_seek += min_distance;
-            current_pos = req_copy[index];
-            serviced[index] = 1; // Mark as serviced
-            serviced_count++;
-            printf(" -> %d", current_pos);
+        for (size_t i = first; i < last; i++) {
+            dst[offset[(request_key(&src[i]) >> shift) & (RADIX_SIZE - 1)]++] = src[i];
         }
+        pthread_barrier_wait(&r->barrier);
+        struct Request *t = src;
+        src = dst;
+        dst = t;
     }
-    printf("\nTotal SSTF Seek Time: %d\n\n", total_seek);
+    if (th->id == 0) r->result = src;
+    return NULL;
+}
+
+// radix_sort_requests() spread over 'threads' threads
+void radix_sort_requests_parallel(struct Request *a, struct Request *tmp, size_t n, int threads) {
+    if (threads <= 1 || n < RADIX_PARALLEL_MIN) {
+        radix_sort_requests(a, tmp, n);
+        return;
+    }
+
+    struct RadixSort r = { .a = a, .tmp = tmp, .n = n, .threads = threads };
+    r.count = xmalloc((size_t)threads * sizeof(*r.count));
+    struct RadixThread *th = xmalloc(threads * sizeof(struct RadixThread));
+    pthread_t *tid = xmalloc(threads * sizeof(pthread_t));
+    pthread_barrier_init(&r.barrier, NULL, threads);
+    for (int k = 0; k < threads; k++) th[k] = (struct RadixThread){ .r = &r, .id = k };
+    for (int k = 1; k < threads; k++) {
+        if (pthread_create(&tid[k], NULL, radix_worker, &th[k]) != 0) die("cannot start thread");
+    }
+    radix_worker(&th[0]);
+    for (int k = 1; k < threads; k++) pthread_join(tid[k], NULL);
+
+    if (r.result != a) memcpy(a, r.result, n * sizeof(struct Request));
+    pthread_barrier_destroy(&r.barrier);
+    free(r.count);
+    free(th);
+    free(tid);
 }
 
 // ----------------------------------------------------------------
-// 2. SCAN (Elevator Algorithm)
+// The request queue shared by SSTF, SCAN and C-LOOK
+// ----------------------------------------------------------------
+
+// All three algorithms below want the requests in cylinder order. We
+// sort them once into a buffer taken from an arena, and every algorithm
+// walks that same buffer read-only. (Each of them used to copy the list
+// into a variable-length array on the stack and sort its own copy,
+// which overflows the stack at a few hundred thousand requests.)
+
+// A bump allocator: one malloc up front, everything freed in one go
+struct Arena {
+    char  *base;
+    size_t used;
+    size_t size;
+};
+
+void arena_init(struct Arena *a, size_t size) {
+    a->base = xmalloc(size);
+    a->used = 0;
+    a->size = size;
+}
+
+// Blocks are rounded up to 16 bytes so each one stays aligned
+void *arena_alloc(struct Arena *a, size_t size) {
+    size = (size + 15) & ~(size_t)15;
+    if (size > a->size - a->used) die("arena exhausted");
+    void *p = a->base + a->used;
+    a->used += size;
+    return p;
+}
+
+void arena_free(struct Arena *a) {
+    free(a->base);
+    a->base = NULL;
+    a->used = a->size = 0;
+}
+
+// What sstf(), scan() and clook() print
+#define PRINT_TOTAL 1   // the total seek
+#define PRINT_PATH  2   // every stop (off for big batches)
+
+struct RequestQueue {
+    const struct Request *sorted;  // by cylinder, then by position in requests[]
+    int n;
+    int head;
+    int below;          // sorted[0 .. below-1] are below the head
+    int at_or_below;    // sorted[0 .. at_or_below-1] are at or below it
+    int print;          // PRINT_PATH, PRINT_TOTAL or both
+};
+
+// Arena space a queue of n requests needs
+size_t queue_arena_size(int n) {
+    return sizeof(struct RequestQueue) + (size_t)n * sizeof(struct Request) + 32;
+}
+
+// Sorts with 'threads' threads (the scratch buffer is not kept)
+const struct RequestQueue *queue_build(struct Arena *a, const int requests[], int n, int head,
+                                       int print, int threads) {
+    struct Request *sorted = arena_alloc(a, (size_t)n * sizeof(struct Request));
+    for (int i = 0; i < n; i++) {
+        sorted[i].cylinder = requests[i];
+        sorted[i].index = i;
+    }
+    struct Request *tmp = xmalloc((size_t)n * sizeof(struct Request));
+    radix_sort_requests_parallel(sorted, tmp, n, threads);
+    free(tmp);
+
+    struct RequestQueue *q = arena_alloc(a, sizeof(struct RequestQueue));
+    q->sorted = sorted;
+    q->n = n;
+    q->head = head;
+    q->below = 0;
+    while (q->below < n && sorted[q->below].cylinder < head) q->below++;
+    q->at_or_below = q->below;
+    while (q->at_or_below < n && sorted[q->at_or_below].cylinder == head) q->at_or_below++;
+    q->print = print;
+    return q;
+}
+
+// Move the head to cylinder next: add up the seek and print the stop
+static inline void move_head(const struct RequestQueue *q, int *current_pos,
+                             long long *total_seek, int next) {
+    *total_seek += llabs((long long)next - *current_pos);
+    *current_pos = next;
+    if (q->print & PRINT_PATH) printf(" -> %d", next);
+}
+
+// ----------------------------------------------------------------
+// 1. SSTF: Shortest Seek Time First
 // ----------------------------------------------------------------
-void scan(int requests[], int n, int head, int disk_size, char *direction) {
-    // Create a copy and sort it
-    int sorted_req[n];
-    memcpy(sorted_req, requests, n * sizeof(int));
-    qsort(sorted_req, n, sizeof(int), compare);
 
-    int total_seek = 0;
-    int current_pos = head;
+// Once the requests are sorted, the ones we have serviced always form
+// one block around the head, so the closest pending request is either
+// the one just below that block or the one just above it. SSTF is then
+// a walk outwards with two pointers: O(n) after the sort, instead of a
+// scan over every request at every step.
+//
+// When both neighbours are the same distance away, the old scan took
+// whichever came first in requests[]. We keep that rule through the
+// (cylinder, index) order of the queue, so the path is exactly the same.
+long long sstf(const struct RequestQueue *q) {
+    const struct Request *sorted = q->sorted;
+    int n = q->n;
 
-    printf("SCAN Path: %d", current_pos);
+    // sorted[lo] is the closest pending request below the head,
+    // sorted[hi] the closest one at or above it
+    int hi = q->below;
+    int lo = hi - 1;
+
+    long long total_seek = 0;
+    int current_pos = q->head;
+
+    if (q->print & PRINT_PATH) printf("SSTF Path: %d", current_pos);
+
+    while (lo >= 0 || hi < n) {
+        int go_left;
+        if (hi == n) {
+            go_left = 1;
+        } else if (lo < 0) {
+            go_left = 0;
+        } else {
+            long long down = (long long)current_pos - sorted[lo].cylinder;
+            long long up = (long long)sorted[hi].cylinder - current_pos;
+            if (down != up) {
+                go_left = down < up;
+            } else {
+                // A tie: compare the first request (in requests[] order)
+                // for each of the two cylinders
+                int first = lo;
+                while (first > 0 && sorted[first - 1].cylinder == sorted[lo].cylinder) first--;
+                go_left = sorted[first].index < sorted[hi].index;
+            }
+        }
+
+        move_head(q, &current_pos, &total_seek, go_left ? sorted[lo--].cylinder : sorted[hi++].cylinder);
+    }
+    if (q->print & PRINT_PATH) printf("\n");
+    if (q->print & PRINT_TOTAL) printf("Total SSTF Seek Time: %lld\n\n", total_seek);
+    return total_seek;
+}
+
+// ----------------------------------------------------------------
+// 2. SCAN (Elevator Algorithm)
+// ----------------------------------------------------------------
+long long scan(const struct RequestQueue *q, int disk_size, const char *direction) {
+    const struct Request *sorted = q->sorted;
+    long long total_seek = 0;
+    int current_pos = q->head;
+
+    if (q->print & PRINT_PATH) printf("SCAN Path: %d", current_pos);
 
     if (strcmp(direction, "right") == 0) {
         // --- Move Right (UP) ---
         // Service all requests from head to the end
-        for (int i = 0; i < n; i++) {
-            if (sorted_req[i] >= current_pos) {
-                total_seek += abs(sorted_req[i] - current_pos);
-                current_pos = sorted_req[i];
-                printf(" -> %d", current_pos);
-            }
+        for (int i = q->below; i < q->n; i++) {
+            move_head(q, &current_pos, &total_seek, sorted[i].cylinder);
         }
-        
+
         // Go to the very end of the disk
-        printf(" -> %d", disk_size);
-        total_seek += abs(disk_size - current_pos);
-        current_pos = disk_size;
+        move_head(q, &current_pos, &total_seek, disk_size);
 
         // --- Move Left (DOWN) ---
         // Service remaining requests from the end downwards
-        for (int i = n - 1; i >= 0; i--) {
-            if (sorted_req[i] < head) {
-                total_seek += abs(current_pos - sorted_req[i]);
-                current_pos = sorted_req[i];
-                printf(" -> %d", current_pos);
-            }
+        for (int i = q->below - 1; i >= 0; i--) {
+            move_head(q, &current_pos, &total_seek, sorted[i].cylinder);
         }
     } else { // Direction is "left"
         // --- Move Left (DOWN) ---
         // Service all requests from head to the beginning
-        for (int i = n - 1; i >= 0; i--) {
-            if (sorted_req[i] <= current_pos) {
-                total_seek += abs(current_pos - sorted_req[i]);
-                current_pos = sorted_req[i];
-                printf(" -> %d", current_pos);
-            }
+        for (int i = q->at_or_below - 1; i >= 0; i--) {
+            move_head(q, &current_pos, &total_seek, sorted[i].cylinder);
         }
 
         // Go to the very beginning of the disk
-        printf(" -> 0");
-        total_seek += abs(current_pos - 0);
-        current_pos = 0;
+        move_head(q, &current_pos, &total_seek, 0);
 
         // --- Move Right (UP) ---
         // Service remaining requests from 0 upwards
-        for (int i = 0; i < n; i++) {
-            if (sorted_req[i] > head) {
-                total_seek += abs(sorted_req[i] - current_pos);
-                current_pos = sorted_req[i];
-                printf(" -> %d", current_pos);
-            }
+        for (int i = q->at_or_below; i < q->n; i++) {
+            move_head(q, &current_pos, &total_seek, sorted[i].cylinder);
         }
     }
 
-    printf("\nTotal SCAN Seek Time: %d\n\n", total_seek);
+    if (q->print & PRINT_PATH) printf("\n");
+    if (q->print & PRINT_TOTAL) printf("Total SCAN Seek Time: %lld\n\n", total_seek);
+    return total_seek;
 }
 
 // ----------------------------------------------------------------
 // 3. C-LOOK (Circular-LOOK)
 // ----------------------------------------------------------------
-void clook(int requests[], int n, int head, char *direction) {
-    // Create a copy and sort it
-    int sorted_req[n];
-    memcpy(sorted_req, requests, n * sizeof(int));
-    qsort(sorted_req, n, sizeof(int), compare);
+long long clook(const struct RequestQueue *q, const char *direction) {
+    const struct Request *sorted = q->sorted;
+    long long total_seek = 0;
+    int current_pos = q->head;
 
-    int total_seek = 0;
-    int current_pos = head;
-
-    printf("C-LOOK Path: %d", current_pos);
+    if (q->print & PRINT_PATH) printf("C-LOOK Path: %d", current_pos);
 
     if (strcmp(direction, "right") == 0) {
         // --- Move Right (UP) ---
         // Service all requests from head to the *last* request
-        for (int i = 0; i < n; i++) {
-            if (sorted_req[i] >= current_pos) {
-                total_seek += abs(sorted_req[i] - current_pos);
-                current_pos = sorted_req[i];
-                printf(" -> %d", current_pos);
-            }
+        for (int i = q->below; i < q->n; i++) {
+            move_head(q, &current_pos, &total_seek, sorted[i].cylinder);
         }
 
         // --- JUMP ---
-        // Jump from the last request (highest) to the first (lowest)
+        // Jump from the last request (highest) to the first (lowest),
+        // if any are left below the head
         // Note: The jump itself is seek time!
-        total_seek += abs(current_pos - sorted_req[0]);
-        current_pos = sorted_req[0];
-        printf(" -> %d", current_pos);
+        if (q->below > 0) move_head(q, &current_pos, &total_seek, sorted[0].cylinder);
 
         // --- Move Right (UP) again ---
         // Service remaining requests from the beginning
-        for (int i = 1; i < n; i++) {
-            if (sorted_req[i] < head) {
-                total_seek += abs(sorted_req[i] - current_pos);
-                current_pos = sorted_req[i];
-                printf(" -> %d", current_pos);
-            } else {
-                // We've reached the requests we already serviced
-                break;
-            }
+        for (int i = 1; i < q->below; i++) {
+            move_head(q, &current_pos, &total_seek, sorted[i].cylinder);
         }
     } else { // Direction is "left"
         // --- Move Left (DOWN) ---
         // Service all requests from head to the *first* request
-        for (int i = n - 1; i >= 0; i--) {
-            if (sorted_req[i] <= current_pos) {
-                total_seek += abs(current_pos - sorted_req[i]);
-                current_pos = sorted_req[i];
-                printf(" -> %d", current_pos);
-            }
+        for (int i = q->at_or_below - 1; i >= 0; i--) {
+            move_head(q, &current_pos, &total_seek, sorted[i].cylinder);
         }
 
         // --- JUMP ---
-        // Jump from the first request (lowest) to the last (highest)
-        total_seek += abs(sorted_req[n-1] - current_pos);
-        current_pos = sorted_req[n-1];
-        printf(" -> %d", current_pos);
+        // Jump from the first request (lowest) to the last (highest),
+        // if any are left above the head
+        if (q->at_or_below < q->n) move_head(q, &current_pos, &total_seek, sorted[q->n - 1].cylinder);
 
         // --- Move Left (DOWN) again ---
         // Service remaining requests from the top
-        for (int i = n - 2; i >= 0; i--) {
-            if (sorted_req[i] > head) {
-                total_seek += abs(current_pos - sorted_req[i]);
-                current_pos = sorted_req[i];
-                printf(" -> %d", current_pos);
-            } else {
-                break;
-            }
+        for (int i = q->n - 2; i >= q->at_or_below; i--) {
+            move_head(q, &current_pos, &total_seek, sorted[i].cylinder);
+        }
+    }
+
+    if (q->print & PRINT_PATH) printf("\n");
+    if (q->print & PRINT_TOTAL) printf("Total C-LOOK Seek Time: %lld\n\n", total_seek);
+    return total_seek;
+}
+
+// ----------------------------------------------------------------
+// 4. Online scheduling: requests arrive while the head moves
+// ----------------------------------------------------------------
+
+// The functions above see the whole request list up front. A real block
+// layer does not: requests keep arriving while the head is busy. Here
+// every request has an arrival time, and the pending ones sit in a skip
+// list ordered by cylinder, so "the closest request above (or below)
+// the head" is an O(log n) search instead of a scan.
+//
+// Time model: moving the head one cylinder takes one time unit, and
+// each request then takes 'service' more units. Once the head sets off
+// for a request it finishes it; requests that arrive in the meantime
+// are seen when it is done. An idle disk waits for the next arrival
+// without moving.
+
+#define SKIP_MAX_LEVEL 32
+
+// Pending requests, grouped by cylinder: one node per cylinder that has
+// requests waiting, holding them in arrival order. Nodes live in one
+// int array; the node at offset x is
+//
+//   pool[x]          its cylinder
+//   pool[x + 1]      first waiting request, pool[x + 2] the last one
+//   pool[x + 3 + l]  offset of the next node on level l (-1 = none)
+//
+// so a search touches one cache line per node it visits. The node for
+// a cylinder is made by the first request to arrive there and lives in
+// space set aside for that request (its level is drawn up front), so
+// nothing is allocated while the simulation runs. Offset 0 is the list
+// head.
+//
+// The head hardly ever moves far between two picks, so searches near
+// the head start from the last one: finger[l] is the last node on level
+// l below finger_key. Climbing only as many levels as it takes to get
+// past the new key makes such a search O(log d) for a key d nodes away
+// instead of O(log n). New requests land anywhere on the disk, so
+// inserts search from the top and just fix up the finger.
+struct SkipList {
+    int *pool;
+    int *slot;          // slot[i] = where request i's node would go
+    int *level;         // level[i] = how many levels that node has
+    int *next_same;     // next request waiting on the same cylinder
+    int  top;           // levels in use
+    int  count;         // requests waiting
+    int  finger[SKIP_MAX_LEVEL];
+    int  finger_key;
+};
+
+#define SKIP_HEAD 0
+
+// SplitMix64: a small, fast, seedable generator
+static inline unsigned long long rng_next(unsigned long long *state) {
+    unsigned long long z = (*state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+void skip_init(struct SkipList *s, int n) {
+    s->slot = xmalloc(n * sizeof(int));
+    s->level = xmalloc(n * sizeof(int));
+    s->next_same = xmalloc(n * sizeof(int));
+
+    // Level k with probability 1/2^k, so two links per node on average
+    unsigned long long seed = 42;
+    long long size = 3 + SKIP_MAX_LEVEL;
+    for (int i = 0; i < n; i++) {
+        unsigned long long r = rng_next(&seed) | (1ull << (SKIP_MAX_LEVEL - 1));
+        s->level[i] = 1 + __builtin_ctzll(r);
+        s->slot[i] = (int)size;
+        size += 3 + s->level[i];
+        if (size > INT_MAX) die("too many requests");
+    }
+    s->pool = xmalloc(size * sizeof(int));
+    for (int l = 0; l < SKIP_MAX_LEVEL; l++) {
+        s->pool[SKIP_HEAD + 3 + l] = -1;
+        s->finger[l] = SKIP_HEAD;
+    }
+    s->finger_key = INT_MIN;
+    s->top = 1;
+    s->count = 0;
+}
+
+void skip_free(struct SkipList *s) {
+    free(s->pool);
+    free(s->slot);
+    free(s->level);
+    free(s->next_same);
+}
+
+static inline int *skip_next(const struct SkipList *s, int x, int l) {
+    return &s->pool[x + 3 + l];
+}
+
+static inline int skip_below(const struct SkipList *s, int x, int c) {
+    return x == SKIP_HEAD || s->pool[x] < c;
+}
+
+// The last node below cylinder c, or the list head, searching from the
+// top. update gets the last such node on every level in use.
+int skip_find(const struct SkipList *s, int c, int *update) {
+    int x = SKIP_HEAD;
+    for (int l = s->top - 1; l >= 0; l--) {
+        int next;
+        while ((next = *skip_next(s, x, l)) >= 0 && s->pool[next] < c) x = next;
+        update[l] = x;
+    }
+    return x;
+}
+
+// The same, searching from the finger, and moving the finger to c
+int skip_seek(struct SkipList *s, int c) {
+    // Climb until the finger is below c and its successor is not; the
+    // fingers above that level are then right for c as well
+    int l = 0;
+    while (l < s->top - 1) {
+        int f = s->finger[l], next = *skip_next(s, f, l);
+        if (skip_below(s, f, c) && (next < 0 || s->pool[next] >= c)) break;
+        l++;
+    }
+    int x = skip_below(s, s->finger[l], c) ? s->finger[l] : SKIP_HEAD;
+    for (; l >= 0; l--) {
+        int next;
+        while ((next = *skip_next(s, x, l)) >= 0 && s->pool[next] < c) x = next;
+        s->finger[l] = x;
+    }
+    s->finger_key = c;
+    return x;
+}
+
+// Add request id, waiting on cylinder c
+void skip_insert(struct SkipList *s, int id, int c) {
+    int update[SKIP_MAX_LEVEL];
+    int x = *skip_next(s, skip_find(s, c, update), 0);
+    s->next_same[id] = -1;
+    s->count++;
+    if (x >= 0 && s->pool[x] == c) {
+        // The cylinder already has a node: queue behind the others
+        s->next_same[s->pool[x + 2]] = id;
+        s->pool[x + 2] = id;
+        return;
+    }
+
+    x = s->slot[id];
+    int level = s->level[id];
+    s->pool[x] = c;
+    s->pool[x + 1] = s->pool[x + 2] = id;
+    for (int l = s->top; l < level; l++) update[l] = SKIP_HEAD;
+    if (level > s->top) s->top = level;
+    for (int l = 0; l < level; l++) {
+        *skip_next(s, x, l) = *skip_next(s, update[l], l);
+        *skip_next(s, update[l], l) = x;
+        // Landed between the finger and its key: now the last node below
+        if (s->finger[l] == update[l] && c < s->finger_key) s->finger[l] = x;
+    }
+}
+
+// Take the oldest request waiting at node x; the node goes when it is
+// the last one
+int skip_pop(struct SkipList *s, int x) {
+    int id = s->pool[x + 1];
+    s->count--;
+    if (id != s->pool[x + 2]) {
+        s->pool[x + 1] = s->next_same[id];
+        return id;
+    }
+
+    int *update = s->finger;
+    skip_seek(s, s->pool[x]);
+    for (int l = 0; l < s->top && *skip_next(s, update[l], l) == x; l++) {
+        *skip_next(s, update[l], l) = *skip_next(s, x, l);
+    }
+    return id;
+}
+
+// Node of the lowest waiting cylinder >= c, or -1
+int skip_ceiling(struct SkipList *s, int c) {
+    return *skip_next(s, skip_seek(s, c), 0);
+}
+
+// Node of the highest waiting cylinder <= c, or -1
+int skip_floor(struct SkipList *s, int c) {
+    int x = skip_seek(s, c);
+    int next = *skip_next(s, x, 0);
+    if (next >= 0 && s->pool[next] == c) return next;
+    return x == SKIP_HEAD ? -1 : x;
+}
+
+// --- The simulation ---
+
+// Every policy sits behind one interface. admit() is told about each
+// request as it arrives. pick() is called whenever the disk is free and
+// something is waiting; it returns the request to serve next, already
+// taken out of the policy's queues, and may move the head first (SCAN
+// runs on to the end of the disk). finish(), when present, runs after
+// the last request. init() and fini(), when present, set up and free
+// queues beyond the shared cylinder-ordered list.
+struct Online;
+
+struct DiskPolicy {
+    const char *name;       // for -p
+    const char *about;      // one line for the usage message
+    void (*init)(struct Online *o);
+    void (*fini)(struct Online *o);
+    void (*admit)(struct Online *o, int id);
+    int  (*pick)(struct Online *o);
+    void (*finish)(struct Online *o);
+};
+
+#define READ  0
+#define WRITE 1
+
+// Deadline: how many read batches may go ahead of waiting writes before
+// the writes get one (mq-deadline's writes_starved)
+#define WRITES_STARVED 2
+
+struct Online {
+    // The workload
+    const long long *arrival;
+    const int *cylinder;
+    const unsigned char *write;     // write[i]: request i is a write (NULL = all reads)
+    int  n;
+    int *order;             // request numbers by arrival time
+    // Settings
+    const struct DiskPolicy *policy;
+    int  up;                // moving towards higher cylinders
+    int  disk_size;
+    long long service;
+    int  batch;             // N for N-step SCAN, requests per batch for deadline
+    long long expire[2];    // deadline: how long reads / writes may wait
+    int  print_path;
+    // State
+    struct SkipList pending[2];     // waiting requests; deadline keeps writes in [WRITE]
+    int  waiting;           // admitted but not served yet
+    int  admitted;          // order[0 .. admitted) are in the queues or done
+    int  queued;            // N-step SCAN, FSCAN: order[queued .. admitted) wait for the next batch
+    int  turned;            // SCAN has turned at an end of the disk
+    int  pos;
+    long long now;
+    long long total_seek;
+    long long *response;    // response[i] = finish - arrival of request i
+    // Deadline
+    int *fifo[2];           // reads / writes in arrival order
+    int  fifo_head[2], fifo_tail[2];
+    unsigned char *served;
+    int  dir;               // READ or WRITE: what the current batch serves
+    int  batch_left;
+    int  starved;           // read batches picked while writes waited
+};
+
+// Hand every request that has arrived by now to the policy
+void online_admit(struct Online *o) {
+    while (o->admitted < o->n && o->arrival[o->order[o->admitted]] <= o->now) {
+        int id = o->order[o->admitted++];
+        o->waiting++;
+        o->policy->admit(o, id);
+    }
+}
+
+// The path shows where the head goes, so requests served back to back
+// on one cylinder make a single stop
+void online_move(struct Online *o, int cyl) {
+    if (cyl == o->pos) return;
+    long long distance = llabs((long long)cyl - o->pos);
+    o->total_seek += distance;
+    o->now += distance;
+    o->pos = cyl;
+    if (o->print_path) printf(" -> %d", cyl);
+}
+
+// --- Picking from a cylinder-ordered list ---
+// These return the node to serve next in s, which is not empty
+
+// Did the first request waiting at node x arrive before the one at y?
+int online_older(const struct Online *o, const struct SkipList *s, int x, int y) {
+    int a = s->pool[x + 1], b = s->pool[y + 1];
+    if (o->arrival[a] != o->arrival[b]) return o->arrival[a] < o->arrival[b];
+    return a < b;
+}
+
+// The closest request. One search finds both neighbours of the head.
+int pick_closest(struct Online *o, struct SkipList *s) {
+    int below = skip_seek(s, o->pos);
+    int above = *skip_next(s, below, 0);
+    if (below == SKIP_HEAD) return above;
+    if (above < 0) return below;
+    int up = s->pool[above] - o->pos, down = o->pos - s->pool[below];
+    if (up != down) return up < down ? above : below;
+    return online_older(o, s, above, below) ? above : below;
+}
+
+// The next request in the direction of travel, or -1
+int pick_ahead(struct Online *o, struct SkipList *s) {
+    return o->up ? skip_ceiling(s, o->pos) : skip_floor(s, o->pos);
+}
+
+// SCAN: past the last request, run on to the end of the disk and turn
+int pick_scan(struct Online *o, struct SkipList *s) {
+    for (;;) {
+        int r = pick_ahead(o, s);
+        if (r >= 0) return r;
+        int end = o->up ? o->disk_size : 0;
+        if (o->pos != end) {
+            online_move(o, end);
+            online_admit(o);
+        }
+        o->up = !o->up;
+        o->turned = 1;
+    }
+}
+
+// Like scan(), SCAN runs its first sweep on to the end of the disk even
+// when nothing is left ahead; only a sweep after a turn stops at its
+// last request. The requests are all done by then, so the extra travel
+// counts as seek but not in the finish time.
+void scan_finish(struct Online *o) {
+    int end = o->up ? o->disk_size : 0;
+    if (o->turned || o->pos == end) return;
+    long long done = o->now;
+    online_move(o, end);
+    o->now = done;
+}
+
+// LOOK: turn at the last request instead
+int pick_look(struct Online *o, struct SkipList *s) {
+    int r = pick_ahead(o, s);
+    if (r >= 0) return r;
+    o->up = !o->up;
+    return pick_ahead(o, s);
+}
+
+// C-SCAN: run on to the end of the disk, return to the other end
+// (the return counts as seek) and sweep the same way again
+int pick_cscan(struct Online *o, struct SkipList *s) {
+    int r = pick_ahead(o, s);
+    if (r >= 0) return r;
+    int end = o->up ? o->disk_size : 0;
+    if (o->pos != end) online_move(o, end);
+    online_move(o, o->up ? 0 : o->disk_size);
+    online_admit(o);
+    return pick_ahead(o, s);
+}
+
+// C-LOOK: past the last request, jump back to the request at the far end
+int pick_clook(struct Online *o, struct SkipList *s) {
+    int r = pick_ahead(o, s);
+    if (r < 0) r = o->up ? skip_ceiling(s, INT_MIN) : skip_floor(s, INT_MAX);
+    return r;
+}
+
+// --- The policies ---
+
+// SSTF, SCAN, LOOK, C-SCAN, C-LOOK: every waiting request in one list
+void sorted_admit(struct Online *o, int id) {
+    skip_insert(&o->pending[READ], id, o->cylinder[id]);
+}
+
+int sstf_pick(struct Online *o)  { return skip_pop(&o->pending[READ], pick_closest(o, &o->pending[READ])); }
+int scan_pick(struct Online *o)  { return skip_pop(&o->pending[READ], pick_scan(o, &o->pending[READ])); }
+int look_pick(struct Online *o)  { return skip_pop(&o->pending[READ], pick_look(o, &o->pending[READ])); }
+int cscan_pick(struct Online *o) { return skip_pop(&o->pending[READ], pick_cscan(o, &o->pending[READ])); }
+int clook_pick(struct Online *o) { return skip_pop(&o->pending[READ], pick_clook(o, &o->pending[READ])); }
+
+// N-step SCAN and FSCAN: SCAN over a frozen batch, so a stream of new
+// requests near the head cannot hold the others back. Arrivals wait in
+// order[queued .. admitted) and the next batch is taken when the list
+// runs dry: up to N requests for N-step SCAN, all of them for FSCAN.
+void frozen_admit(struct Online *o, int id) {
+    (void)o;
+    (void)id;
+}
+
+int frozen_pick(struct Online *o, int size) {
+    struct SkipList *s = &o->pending[READ];
+    if (s->count == 0) {
+        int end = o->admitted - o->queued > size ? o->queued + size : o->admitted;
+        for (; o->queued < end; o->queued++) {
+            int id = o->order[o->queued];
+            skip_insert(s, id, o->cylinder[id]);
+        }
+    }
+    return skip_pop(s, pick_scan(o, s));
+}
+
+int nstep_pick(struct Online *o) { return frozen_pick(o, o->batch); }
+int fscan_pick(struct Online *o) { return frozen_pick(o, INT_MAX); }
+
+// Deadline, after Linux mq-deadline. Reads and writes each have a list
+// by cylinder and a FIFO by arrival. Requests go in batches of up to
+// 'batch', in ascending cylinder order. Each new batch serves reads,
+// unless writes have been passed over WRITES_STARVED times. It starts
+// at the head, or at the oldest request if that one has waited longer
+// than its expiry time or nothing is left ahead of the head.
+void deadline_init(struct Online *o) {
+    skip_init(&o->pending[WRITE], o->n);
+    for (int d = READ; d <= WRITE; d++) {
+        o->fifo[d] = xmalloc((size_t)o->n * sizeof(int));
+        o->fifo_head[d] = o->fifo_tail[d] = 0;
+    }
+    o->served = xmalloc(o->n);
+    memset(o->served, 0, o->n);
+    o->dir = READ;
+    o->batch_left = 0;
+    o->starved = 0;
+}
+
+void deadline_fini(struct Online *o) {
+    skip_free(&o->pending[WRITE]);
+    free(o->fifo[READ]);
+    free(o->fifo[WRITE]);
+    free(o->served);
+}
+
+static inline int request_dir(const struct Online *o, int id) {
+    return o->write != NULL && o->write[id] ? WRITE : READ;
+}
+
+void deadline_admit(struct Online *o, int id) {
+    int d = request_dir(o, id);
+    skip_insert(&o->pending[d], id, o->cylinder[id]);
+    o->fifo[d][o->fifo_tail[d]++] = id;
+}
+
+// The oldest waiting request in direction d. Requests served out of
+// FIFO order are dropped from the front here, once each.
+int deadline_oldest(struct Online *o, int d) {
+    while (o->served[o->fifo[d][o->fifo_head[d]]]) o->fifo_head[d]++;
+    return o->fifo[d][o->fifo_head[d]];
+}
+
+int deadline_pick(struct Online *o) {
+    int d = o->dir, x = -1;
+    if (o->batch_left > 0) x = skip_ceiling(&o->pending[d], o->pos);
+    if (x < 0) {
+        // A new batch
+        int reads = o->pending[READ].count > 0, writes = o->pending[WRITE].count > 0;
+        if (reads && !(writes && o->starved++ >= WRITES_STARVED)) {
+            d = READ;
+        } else {
+            d = WRITE;
+            o->starved = 0;
+        }
+        int oldest = deadline_oldest(o, d);
+        x = skip_ceiling(&o->pending[d], o->pos);
+        if (x < 0 || o->arrival[oldest] + o->expire[d] <= o->now) {
+            x = skip_ceiling(&o->pending[d], o->cylinder[oldest]);
+        }
+        o->dir = d;
+        o->batch_left = o->batch;
+    }
+    o->batch_left--;
+    int id = skip_pop(&o->pending[d], x);
+    o->served[id] = 1;
+    return id;
+}
+
+static const struct DiskPolicy policies[] = {
+    { "sstf",     "closest request first",
+      NULL,          NULL,          sorted_admit,   sstf_pick,     NULL        },
+    { "scan",     "sweep to the end of the disk and turn (the first sweep always gets there)",
+      NULL,          NULL,          sorted_admit,   scan_pick,     scan_finish },
+    { "look",     "sweep to the last request and turn",
+      NULL,          NULL,          sorted_admit,   look_pick,     NULL        },
+    { "cscan",    "sweep to the end of the disk, return to the other end, sweep again",
+      NULL,          NULL,          sorted_admit,   cscan_pick,    NULL        },
+    { "clook",    "sweep to the last request, jump back to the first",
+      NULL,          NULL,          sorted_admit,   clook_pick,    NULL        },
+    { "nstep",    "SCAN over frozen batches of -N requests in arrival order",
+      NULL,          NULL,          frozen_admit,   nstep_pick,    scan_finish },
+    { "fscan",    "SCAN over a frozen batch of everything waiting",
+      NULL,          NULL,          frozen_admit,   fscan_pick,    scan_finish },
+    { "deadline", "ascending batches of -N, reads first, oldest first past -R/-W",
+      deadline_init, deadline_fini, deadline_admit, deadline_pick, NULL        },
+};
+
+#define POLICY_COUNT (int)(sizeof(policies) / sizeof(policies[0]))
+
+void online_run(struct Online *o) {
+    skip_init(&o->pending[READ], o->n);
+    o->waiting = o->admitted = o->queued = o->turned = 0;
+    o->now = 0;
+    o->total_seek = 0;
+    if (o->policy->init != NULL) o->policy->init(o);
+    for (int done = 0; done < o->n; done++) {
+        online_admit(o);
+        if (o->waiting == 0) {
+            o->now = o->arrival[o->order[o->admitted]];
+            online_admit(o);
         }
+        int r = o->policy->pick(o);
+        online_move(o, o->cylinder[r]);
+        o->now += o->service;
+        o->waiting--;
+        o->response[r] = o->now - o->arrival[r];
     }
+    if (o->policy->finish != NULL) o->policy->finish(o);
+    if (o->policy->fini != NULL) o->policy->fini(o);
+    skip_free(&o->pending[READ]);
+}
+
+// Request numbers in order of arrival (ties keep their order)
+static const long long *sort_arrival;
+
+int compare_arrival(const void *a, const void *b) {
+    int x = *(const int *)a, y = *(const int *)b;
+    if (sort_arrival[x] != sort_arrival[y]) return sort_arrival[x] < sort_arrival[y] ? -1 : 1;
+    return (x > y) - (x < y);
+}
+
+// For qsort(); used to check radix_sort_ll()
+int compare_long(const void *a, const void *b) {
+    long long x = *(const long long *)a, y = *(const long long *)b;
+    return (x > y) - (x < y);
+}
+
+double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Read "arrival cylinder [R|W]" lines; no letter means a read. write_out
+// may be NULL for callers that do not care.
+int load_requests(const char *path, long long **arrival_out, int **cylinder_out,
+                  unsigned char **write_out) {
+    FILE *f = fopen(path, "r");
+    if (f == NULL) die("cannot open request file");
+    int cap = 1024, n = 0;
+    long long *arrival = xmalloc(cap * sizeof(long long));
+    int *cylinder = xmalloc(cap * sizeof(int));
+    unsigned char *write = xmalloc(cap);
+    char line[256];
+    while (fgets(line, sizeof(line), f) != NULL) {
+        long long t;
+        int c;
+        char kind = 'R';
+        int fields = sscanf(line, "%lld %d %c", &t, &c, &kind);
+        if (fields < 2) {
+            if (strspn(line, " \t\r\n") == strlen(line)) continue;
+            die("bad request line: need \"arrival cylinder [R|W]\"");
+        }
+        if (t < 0 || c < 0) die("bad request: need arrival >= 0 and cylinder >= 0");
+        if (n == cap) {
+            if (cap > INT_MAX / 2) die("too many requests");
+            cap *= 2;
+            arrival = realloc(arrival, cap * sizeof(long long));
+            cylinder = realloc(cylinder, cap * sizeof(int));
+            write = realloc(write, cap);
+            if (arrival == NULL || cylinder == NULL || write == NULL) die("out of memory");
+        }
+        arrival[n] = t;
+        cylinder[n] = c;
+        write[n] = kind == 'W' || kind == 'w';
+        n++;
+    }
+    fclose(f);
+    *arrival_out = arrival;
+    *cylinder_out = cylinder;
+    if (write_out != NULL) *write_out = write;
+    else free(write);
+    return n;
+}
+
+// n random requests on cylinders 0..disk_size, arriving on average
+// every 'gap' time units
+void random_requests(int n, int disk_size, long long gap, long long *arrival, int *cylinder) {
+    unsigned long long seed = 42;
+    long long t = 0;
+    for (int i = 0; i < n; i++) {
+        arrival[i] = t;
+        cylinder[i] = (int)(rng_next(&seed) % ((unsigned long long)disk_size + 1));
+        t += (long long)(rng_next(&seed) % (2 * (unsigned long long)gap + 1));
+    }
+}
+
+// Make about 'percent' of n requests writes. Uses its own seed, so the
+// arrivals and cylinders do not depend on it.
+void random_writes(int n, int percent, unsigned char *write) {
+    unsigned long long seed = 43;
+    for (int i = 0; i < n; i++) write[i] = rng_next(&seed) % 100 < (unsigned long long)percent;
+}
 
-    printf("\nTotal C-LOOK Seek Time: %d\n\n", total_seek);
+// Response times in exact percentiles; sorts v
+struct Summary {
+    double    mean;
+    long long p50, p90, p99, p999, max;
+};
+
+long long percentile(const long long *sorted, int n, double q) {
+    long long rank = (long long)(q * n);
+    if (rank < q * n || rank < 1) rank++;
+    return sorted[rank - 1];
+}
+
+void summarize(long long *v, int n, struct Summary *s) {
+    long long total = 0;
+    for (int i = 0; i < n; i++) total += v[i];
+    long long *tmp = xmalloc((size_t)n * sizeof(long long));
+    radix_sort_ll(v, tmp, n);
+    free(tmp);
+    s->mean = n ? (double)total / n : 0;
+    s->p50 = n ? percentile(v, n, 0.5) : 0;
+    s->p90 = n ? percentile(v, n, 0.9) : 0;
+    s->p99 = n ? percentile(v, n, 0.99) : 0;
+    s->p999 = n ? percentile(v, n, 0.999) : 0;
+    s->max = n ? v[n - 1] : 0;
+}
+
+void print_summary(const char *label, const struct Summary *s) {
+    printf("%s: mean %.2f, p50 %lld, p90 %lld, p99 %lld, p99.9 %lld, max %lld\n", label, s->mean, s->p50,
+           s->p90, s->p99, s->p999, s->max);
+}
+
+void online_usage(void) {
+    fprintf(stderr, "usage: disksim online [-p policy|all] [-H head] [-d disk_size] [-r right|left]\n"
+                    "                      [-t service] [-n requests] [-g gap] [-w write_percent]\n"
+                    "                      [-N batch] [-R read_expire] [-W write_expire] [requests.txt]\n"
+                    "policies:\n");
+    for (int k = 0; k < POLICY_COUNT; k++) fprintf(stderr, "  %-9s %s\n", policies[k].name, policies[k].about);
+    fprintf(stderr, "With every arrival at 0 and -t 0, sstf, scan and clook give the same seek totals\n"
+                    "as the static versions, and so do fscan and nstep with -N at least the request\n"
+                    "count (see disksim check).\n");
+    exit(2);
+}
+
+// Run one policy and print its results, or with label_all just one row
+// of the -p all table. Leaves response[] sorted.
+void online_report(struct Online *o, int head, int up, const char *label_all) {
+    o->pos = head;
+    o->up = up;
+    if (o->print_path) printf("Path: %d", head);
+    double start = now_sec();
+    online_run(o);
+    double elapsed = now_sec() - start;
+    if (o->print_path) printf("\n");
+
+    // Split before summarize() sorts the response times
+    int reads = 0, writes = 0;
+    long long *read_rt = NULL, *write_rt = NULL;
+    if (label_all == NULL && o->write != NULL) {
+        read_rt = xmalloc((size_t)o->n * sizeof(long long));
+        write_rt = xmalloc((size_t)o->n * sizeof(long long));
+        for (int i = 0; i < o->n; i++) {
+            if (o->write[i]) write_rt[writes++] = o->response[i];
+            else read_rt[reads++] = o->response[i];
+        }
+    }
+
+    struct Summary all;
+    summarize(o->response, o->n, &all);
+    if (label_all != NULL) {
+        // One row of the -p all table
+        printf("%-10s %12lld %12lld %10.2f %10.2f %9lld %9lld %9lld %9lld %8.3f\n", label_all, o->total_seek,
+               o->now, o->now ? o->n * 1000.0 / o->now : 0.0, all.mean, all.p50, all.p99, all.p999, all.max,
+               elapsed);
+        return;
+    }
+
+    printf("Total Seek Distance: %lld\n", o->total_seek);
+    printf("Finished at: %lld\n", o->now);
+    print_summary("Response Time", &all);
+    if (writes > 0) {
+        struct Summary r, w;
+        summarize(read_rt, reads, &r);
+        summarize(write_rt, writes, &w);
+        print_summary("  Reads", &r);
+        print_summary("  Writes", &w);
+    }
+    free(read_rt);
+    free(write_rt);
+    printf("Time: %.3f s (%.1f ns/request)\n", elapsed, elapsed * 1e9 / o->n);
+}
+
+// disksim online: replay timed requests (a file of "arrival cylinder
+// [R|W]" lines, or -n random ones) under one policy, or under all of
+// them side by side, and report response times
+int online_main(int argc, char *argv[]) {
+    struct Online o = { .disk_size = 199, .service = 1, .batch = 16, .expire = { 500, 5000 } };
+    const char *policy = "sstf";
+    int head = 53, up = 1, random_count = 0, write_percent = 30;
+    long long gap = 40;
+    int opt;
+    optind = 2;
+    while ((opt = getopt(argc, argv, "p:H:d:r:t:n:g:w:N:R:W:")) != -1) {
+        switch (opt) {
+        case 'p': policy = optarg; break;
+        case 'H': head = atoi(optarg); break;
+        case 'd': o.disk_size = atoi(optarg); break;
+        case 'r': up = strcmp(optarg, "left") != 0; break;
+        case 't': o.service = atoll(optarg); break;
+        case 'n': random_count = atoi(optarg); break;
+        case 'g': gap = atoll(optarg); break;
+        case 'w': write_percent = atoi(optarg); break;
+        case 'N': o.batch = atoi(optarg); break;
+        case 'R': o.expire[READ] = atoll(optarg); break;
+        case 'W': o.expire[WRITE] = atoll(optarg); break;
+        default:  online_usage();
+        }
+    }
+    int all = strcmp(policy, "all") == 0;
+    for (int k = 0; k < POLICY_COUNT; k++) {
+        if (strcmp(policy, policies[k].name) == 0) o.policy = &policies[k];
+    }
+    if (o.policy == NULL && !all) online_usage();
+    if (o.disk_size < 0 || head < 0 || head > o.disk_size || o.service < 0 || gap < 0) {
+        die("need 0 <= head <= disk_size and a non-negative service time and gap");
+    }
+    if (o.batch < 1 || o.expire[READ] < 0 || o.expire[WRITE] < 0) {
+        die("need a batch of at least 1 and non-negative expiry times");
+    }
+
+    long long *arrival;
+    int *cylinder;
+    unsigned char *write;
+    if (random_count > 0) {
+        o.n = random_count;
+        arrival = xmalloc((size_t)o.n * sizeof(long long));
+        cylinder = xmalloc((size_t)o.n * sizeof(int));
+        write = xmalloc(o.n);
+        random_requests(o.n, o.disk_size, gap, arrival, cylinder);
+        random_writes(o.n, write_percent, write);
+    } else if (optind < argc) {
+        o.n = load_requests(argv[optind], &arrival, &cylinder, &write);
+    } else {
+        online_usage();
+    }
+    if (o.n <= 0) die("no requests");
+    for (int i = 0; i < o.n; i++) {
+        if (cylinder[i] > o.disk_size) die("request beyond the end of the disk");
+    }
+    int writes = 0;
+    for (int i = 0; i < o.n; i++) writes += write[i];
+
+    o.arrival = arrival;
+    o.cylinder = cylinder;
+    o.write = write;
+    o.order = xmalloc((size_t)o.n * sizeof(int));
+    for (int i = 0; i < o.n; i++) o.order[i] = i;
+    sort_arrival = arrival;
+    qsort(o.order, o.n, sizeof(int), compare_arrival);
+    o.response = xmalloc((size_t)o.n * sizeof(long long));
+
+    if (all) {
+        printf("Online, all policies (Requests=%d, Writes=%d, Head=%d, Service=%lld, Batch=%d)\n", o.n, writes,
+               head, o.service, o.batch);
+        printf("%-10s %12s %12s %10s %10s %9s %9s %9s %9s %8s\n", "Policy", "Seek", "Finished", "Req/1000t",
+               "Mean", "p50", "p99", "p99.9", "Max", "Time(s)");
+        for (int k = 0; k < POLICY_COUNT; k++) {
+            o.policy = &policies[k];
+            online_report(&o, head, up, policies[k].name);
+        }
+    } else {
+        o.print_path = o.n <= 20;
+        printf("Online %s (Requests=%d, Head=%d, Service=%lld)\n", o.policy->name, o.n, head, o.service);
+        online_report(&o, head, up, NULL);
+    }
+
+    free(o.order);
+    free(o.response);
+    free(arrival);
+    free(cylinder);
+    free(write);
+    return 0;
+}
+
+// ----------------------------------------------------------------
+// 5. Batch runs: SSTF, SCAN and C-LOOK over one shared queue
+// ----------------------------------------------------------------
+
+void batch_usage(void) {
+    fprintf(stderr, "usage: disksim batch [-H head] [-d disk_size] [-r right|left] [-n requests]\n"
+                    "                     [-j threads] [requests.txt]\n");
+    exit(2);
+}
+
+// disksim batch: run the three static algorithms on a large request
+// list (-n random requests, or the cylinders of an "arrival cylinder"
+// file - arrival times are ignored). The list is sorted once and all
+// three share it. -j sets the threads used for the sort (default: all
+// cores).
+int batch_main(int argc, char *argv[]) {
+    int head = 53, disk_size = 199, random_count = 0, threads = 0;
+    const char *direction = "right";
+    int opt;
+    optind = 2;
+    while ((opt = getopt(argc, argv, "H:d:r:n:j:")) != -1) {
+        switch (opt) {
+        case 'H': head = atoi(optarg); break;
+        case 'd': disk_size = atoi(optarg); break;
+        case 'r': direction = strcmp(optarg, "left") == 0 ? "left" : "right"; break;
+        case 'n': random_count = atoi(optarg); break;
+        case 'j': threads = atoi(optarg); break;
+        default:  batch_usage();
+        }
+    }
+    if (disk_size < 0 || head < 0 || head > disk_size) die("need 0 <= head <= disk_size");
+    if (threads <= 0) threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (threads < 1) threads = 1;
+
+    long long *arrival;
+    int *cylinder;
+    int n = 0;
+    if (random_count > 0) {
+        n = random_count;
+        arrival = xmalloc((size_t)n * sizeof(long long));
+        cylinder = xmalloc((size_t)n * sizeof(int));
+        random_requests(n, disk_size, 1, arrival, cylinder);
+    } else if (optind < argc) {
+        n = load_requests(argv[optind], &arrival, &cylinder, NULL);
+    } else {
+        batch_usage();
+    }
+    free(arrival);
+    if (n <= 0) die("no requests");
+    for (int i = 0; i < n; i++) {
+        if (cylinder[i] > disk_size) die("request beyond the end of the disk");
+    }
+
+    printf("Batch (Requests=%d, Head=%d, Direction=%s, Threads=%d)\n\n", n, head, direction, threads);
+    struct Arena arena;
+    arena_init(&arena, queue_arena_size(n));
+    double start = now_sec();
+    const struct RequestQueue *q = queue_build(&arena, cylinder, n, head, PRINT_TOTAL | (n <= 20 ? PRINT_PATH : 0), threads);
+    printf("Sort: %.3f s\n\n", now_sec() - start);
+    free(cylinder);
+
+    start = now_sec();
+    sstf(q);
+    printf("Time: %.3f s\n\n", now_sec() - start);
+    start = now_sec();
+    scan(q, disk_size, direction);
+    printf("Time: %.3f s\n\n", now_sec() - start);
+    start = now_sec();
+    clook(q, direction);
+    printf("Time: %.3f s\n", now_sec() - start);
+
+    arena_free(&arena);
+    return 0;
+}
+
+// ----------------------------------------------------------------
+// 6. Sort benchmark: radix sort against qsort
+// ----------------------------------------------------------------
+
+void sortbench_usage(void) {
+    fprintf(stderr, "usage: disksim sortbench [-n keys] [-d max_cylinder] [-j threads]\n");
+    exit(2);
+}
+
+void print_sort_time(const char *name, double elapsed, double base, size_t n, int ok) {
+    printf("  %-22s %8.3f s  %7.1f ns/key  %5.1fx  %s\n", name, elapsed, elapsed * 1e9 / n, base / elapsed,
+           ok ? "ok" : "WRONG ORDER");
+}
+
+// disksim sortbench: sort n random requests (cylinders 0..max) and n
+// random 64-bit keys with qsort and with the radix sorts, check that
+// they agree, and time them
+int sortbench_main(int argc, char *argv[]) {
+    int n = 10000000, max_cylinder = 1000000, threads = 0;
+    int opt;
+    optind = 2;
+    while ((opt = getopt(argc, argv, "n:d:j:")) != -1) {
+        switch (opt) {
+        case 'n': n = atoi(optarg); break;
+        case 'd': max_cylinder = atoi(optarg); break;
+        case 'j': threads = atoi(optarg); break;
+        default:  sortbench_usage();
+        }
+    }
+    if (n <= 0 || max_cylinder < 0) sortbench_usage();
+    if (threads <= 0) threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (threads < 1) threads = 1;
+
+    unsigned long long seed = 42;
+    struct Request *input = xmalloc((size_t)n * sizeof(struct Request));
+    struct Request *expected = xmalloc((size_t)n * sizeof(struct Request));
+    struct Request *sorted = xmalloc((size_t)n * sizeof(struct Request));
+    struct Request *tmp = xmalloc((size_t)n * sizeof(struct Request));
+    for (int i = 0; i < n; i++) {
+        input[i].cylinder = (int)(rng_next(&seed) % ((unsigned long long)max_cylinder + 1));
+        input[i].index = i;
+    }
+
+    printf("Requests: %d, cylinders 0..%d\n", n, max_cylinder);
+    size_t bytes = (size_t)n * sizeof(struct Request);
+    memcpy(expected, input, bytes);
+    double start = now_sec();
+    qsort(expected, n, sizeof(struct Request), compare_request);
+    double base = now_sec() - start;
+    print_sort_time("qsort", base, base, n, 1);
+
+    memcpy(sorted, input, bytes);
+    start = now_sec();
+    radix_sort_requests(sorted, tmp, n);
+    print_sort_time("radix", now_sec() - start, base, n, memcmp(sorted, expected, bytes) == 0);
+
+    char name[32];
+    snprintf(name, sizeof(name), "radix, parallel (%d)", threads);
+    memcpy(sorted, input, bytes);
+    start = now_sec();
+    radix_sort_requests_parallel(sorted, tmp, n, threads);
+    print_sort_time(name, now_sec() - start, base, n, memcmp(sorted, expected, bytes) == 0);
+
+    free(input);
+    free(expected);
+    free(sorted);
+    free(tmp);
+
+    // 64-bit keys over the whole range, like LBAs on a big volume
+    long long *keys = xmalloc((size_t)n * sizeof(long long));
+    long long *expected64 = xmalloc((size_t)n * sizeof(long long));
+    long long *tmp64 = xmalloc((size_t)n * sizeof(long long));
+    for (int i = 0; i < n; i++) keys[i] = (long long)rng_next(&seed);
+    bytes = (size_t)n * sizeof(long long);
+
+    printf("64-bit keys: %d\n", n);
+    memcpy(expected64, keys, bytes);
+    start = now_sec();
+    qsort(expected64, n, sizeof(long long), compare_long);
+    base = now_sec() - start;
+    print_sort_time("qsort", base, base, n, 1);
+
+    start = now_sec();
+    radix_sort_ll(keys, tmp64, n);
+    int ok = memcmp(keys, expected64, bytes) == 0;
+    print_sort_time("radix", now_sec() - start, base, n, ok);
+
+    free(keys);
+    free(expected64);
+    free(tmp64);
+    return ok ? 0 : 1;
+}
+
+// ----------------------------------------------------------------
+// 7. Self-check: online policies against the static functions
+// ----------------------------------------------------------------
+
+// When every request arrives at time 0 and service takes no time, the
+// online simulator sees the whole list up front, just like sstf(),
+// scan() and clook(). It must then give the same total seek: SSTF,
+// SCAN and C-LOOK against their static versions, and FSCAN (one frozen
+// batch of everything) and N-step SCAN with N >= n against scan().
+
+void check_usage(void) {
+    fprintf(stderr, "usage: disksim check [-n cases]\n");
+    exit(2);
+}
+
+// Total seek of the online policy with every arrival at time 0
+long long online_seek_at_zero(struct Online *o, const char *policy, int head, int up) {
+    for (int k = 0; k < POLICY_COUNT; k++) {
+        if (strcmp(policy, policies[k].name) == 0) o->policy = &policies[k];
+    }
+    o->pos = head;
+    o->up = up;
+    online_run(o);
+    return o->total_seek;
+}
+
+// disksim check: random small cases, both directions
+int check_main(int argc, char *argv[]) {
+    int cases = 2000;
+    int opt;
+    optind = 2;
+    while ((opt = getopt(argc, argv, "n:")) != -1) {
+        switch (opt) {
+        case 'n': cases = atoi(optarg); break;
+        default:  check_usage();
+        }
+    }
+
+    enum { MAX_REQUESTS = 40 };
+    long long arrival[MAX_REQUESTS] = {0}, response[MAX_REQUESTS];
+    int cylinder[MAX_REQUESTS], order[MAX_REQUESTS];
+    for (int i = 0; i < MAX_REQUESTS; i++) order[i] = i;
+
+    unsigned long long seed = 7;
+    int mismatches = 0;
+    for (int c = 0; c < cases; c++) {
+        int n = 1 + (int)(rng_next(&seed) % MAX_REQUESTS);
+        int disk_size = 1 + (int)(rng_next(&seed) % 300);
+        int head = (int)(rng_next(&seed) % (disk_size + 1));
+        int up = (int)(rng_next(&seed) & 1);
+        for (int i = 0; i < n; i++) cylinder[i] = (int)(rng_next(&seed) % (disk_size + 1));
+        const char *direction = up ? "right" : "left";
+
+        struct Arena arena;
+        arena_init(&arena, queue_arena_size(n));
+        const struct RequestQueue *q = queue_build(&arena, cylinder, n, head, 0, 1);
+        long long want_sstf = sstf(q), want_scan = scan(q, disk_size, direction), want_clook = clook(q, direction);
+        arena_free(&arena);
+
+        struct Online o = { .arrival = arrival, .cylinder = cylinder, .n = n, .order = order,
+                            .disk_size = disk_size, .service = 0, .batch = n, .response = response };
+        struct { const char *policy; long long want; } expect[] = {
+            { "sstf", want_sstf }, { "scan", want_scan }, { "clook", want_clook },
+            { "fscan", want_scan }, { "nstep", want_scan },
+        };
+        for (int k = 0; k < (int)(sizeof(expect) / sizeof(expect[0])); k++) {
+            long long got = online_seek_at_zero(&o, expect[k].policy, head, up);
+            if (got == expect[k].want) continue;
+            if (mismatches++ < 10) {
+                printf("MISMATCH %s: head %d, %s, disk %d, %d requests: online %lld, static %lld\n",
+                       expect[k].policy, head, direction, disk_size, n, got, expect[k].want);
+            }
+        }
+    }
+    printf("Checked %d cases: %s\n", cases, mismatches ? "MISMATCH" : "all match");
+    return mismatches ? 1 : 0;
 }
 
 // ----------------------------------------------------------------
 // Main function to run everything
 // ----------------------------------------------------------------
-int main() {
+int main(int argc, char *argv[]) {
+    // "disksim online|batch|sortbench|check ..." run the modes above
+    if (argc > 1 && strcmp(argv[1], "online") == 0) return online_main(argc, argv);
+    if (argc > 1 && strcmp(argv[1], "batch") == 0) return batch_main(argc, argv);
+    if (argc > 1 && strcmp(argv[1], "sortbench") == 0) return sortbench_main(argc, argv);
+    if (argc > 1 && strcmp(argv[1], "check") == 0) return check_main(argc, argv);
+
     // Our list of "floors" (track requests)
     int requests[] = {98, 183, 37, 122, 14, 124, 65, 67};
     int n = sizeof(requests) / sizeof(requests[0]);
@@ -221,11 +1484,17 @@ int main() {
     // Initial direction of the elevator
     char direction[] = "right";
 
+    // Sort the requests once; every algorithm reads the same queue
+    struct Arena arena;
+    arena_init(&arena, queue_arena_size(n));
+    const struct RequestQueue *q = queue_build(&arena, requests, n, head_start, PRINT_TOTAL | PRINT_PATH, 1);
+
     // Run each algorithm
-    // We pass the ORIGINAL requests array each time
-    sstf(requests, n, head_start);
-    scan(requests, n, head_start, disk_size, direction);
-    clook(requests, n, head_start, direction);
+    sstf(q);
+    scan(q, disk_size, direction);
+    clook(q, direction);
+
+    arena_free(&arena);
 
     return 0;
 }
\ No newline at end of file
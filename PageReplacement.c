@@ -295,6 +295,3368 @@ return 0;
 }
 
 
+//--------------------------------------------------------
+
+// Trace-driven engine
+
+// The two programs above are the "textbook" versions: every reference
+// rescans the frames (and OPT rescans the rest of the reference string),
+// which is fine for 10 pages but unusable on the multi-million-reference
+// traces we replay. This program follows the same rules, so it gives the
+// same fault counts, but uses proper data structures.
+//
+// Usage:
+//   pagesim opt [-f frames] [-c] [-s] [trace]
+//   pagesim lru [-f frames] [-c] [-s] [trace]
+//   pagesim mrc [-f max_frames] [-c] [-s] [trace]
+//   pagesim run [-p policy,...|all] [-f frames] [-t refs] [-c] [-s] [trace]
+//   pagesim sweep [-p policy,...|all] [-f frames,...] [-t refs] [-j threads] [-s] [trace]
+//   pagesim shards [-r rate] [-m max_pages] [-f frames,...] [-c] [-s] [trace]
+//   pagesim cache [-L size:ways:line[:policy],...] [-s] [trace]
+//   pagesim convert [-F raw32|raw64|delta] trace out
+//   pagesim bench-lookup
+//
+//   -f  number of frames (default 3); for mrc, the largest frame count
+//       to report (default: until only first-use faults are left)
+//   -c  also run the textbook algorithm and compare fault counts; for
+//       'shards', print the error against the exact curve and, with -m,
+//       check it against an unlimited run at the final rate
+//   -p  policies for 'run': lru, opt, clock, clockpro, arc, 2q, lirs,
+//       aging, nfu, wsclock (default all)
+//   -t  references per clock tick for aging, nfu and wsclock
+//       (default: one tick per 'frames' references)
+//   -j  worker threads for 'sweep' (default: one per CPU)
+//   -r  starting sampling rate for 'shards' (default 0.01)
+//   -m  most pages 'shards' may track, 0 = no limit (default 8192)
+//   -L  cache levels for 'cache', L1 first; policy is lru (default),
+//       opt or clock (default 32k:8:64,1m:16:64)
+//   -s  read binary traces in fixed-size pieces instead of mmapping
+//   -F  encoding for 'convert' (default delta)
+//
+// A trace is either a text file of page numbers or a binary trace (see
+// "Reference string input" below). With no trace file we use the same
+// reference string as above.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+typedef uint64_t page_t;
+
+// Marks an empty slot in the hash table (no real trace uses this page)
+#define NO_PAGE UINT64_MAX
+
+// Print a message and stop - used when malloc fails or input is bad
+static void die(const char *msg) {
+    fprintf(stderr, "pagesim: %s\n", msg);
+    exit(1);
+}
+
+static void *xmalloc(size_t size) {
+    void *p = malloc(size ? size : 1);
+    if (p == NULL) die("out of memory");
+    return p;
+}
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// CPU time used by the calling thread (not counting time spent waiting
+// for a core, so it stays honest when threads outnumber cores)
+static double thread_cpu_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// ----------------------------------------------------------------
+// Page map: open-addressing hash table, page -> int64 value
+// ----------------------------------------------------------------
+
+// Linear probing over a power-of-two table. The table is kept at most
+// half full so probe sequences stay short.
+struct PageMap {
+    page_t  *keys;
+    int64_t *vals;
+    size_t   mask;    // capacity - 1
+    int      shift;   // 64 - log2(capacity), for Fibonacci hashing
+    size_t   count;
+};
+
+static void pmap_alloc(struct PageMap *m, size_t capacity) {
+    int bits = 4;
+    while (((size_t)1 << bits) < capacity) bits++;
+    capacity = (size_t)1 << bits;
+
+    m->keys = xmalloc(capacity * sizeof(page_t));
+    m->vals = xmalloc(capacity * sizeof(int64_t));
+    for (size_t i = 0; i < capacity; i++) m->keys[i] = NO_PAGE;
+    m->mask = capacity - 1;
+    m->shift = 64 - bits;
+    m->count = 0;
+}
+
+// Make a map that can hold 'expected' pages without growing
+static void pmap_init(struct PageMap *m, size_t expected) {
+    pmap_alloc(m, expected * 2);
+}
+
+static void pmap_free(struct PageMap *m) {
+    free(m->keys);
+    free(m->vals);
+}
+
+static inline size_t pmap_slot(const struct PageMap *m, page_t p) {
+    return (size_t)((p * 0x9E3779B97F4A7C15ull) >> m->shift);
+}
+
+// Returns a pointer to the value stored for page p, or NULL
+static inline int64_t *pmap_find(struct PageMap *m, page_t p) {
+    size_t i = pmap_slot(m, p);
+    while (m->keys[i] != NO_PAGE) {
+        if (m->keys[i] == p) return &m->vals[i];
+        i = (i + 1) & m->mask;
+    }
+    return NULL;
+}
+
+static void pmap_put(struct PageMap *m, page_t p, int64_t v);
+
+static void pmap_grow(struct PageMap *m) {
+    struct PageMap old = *m;
+    pmap_alloc(m, (old.mask + 1) * 2);
+    for (size_t i = 0; i <= old.mask; i++) {
+        if (old.keys[i] != NO_PAGE) pmap_put(m, old.keys[i], old.vals[i]);
+    }
+    pmap_free(&old);
+}
+
+// Insert or update page p
+static void pmap_put(struct PageMap *m, page_t p, int64_t v) {
+    if ((m->count + 1) * 2 > m->mask + 1) pmap_grow(m);
+
+    size_t i = pmap_slot(m, p);
+    while (m->keys[i] != NO_PAGE) {
+        if (m->keys[i] == p) { m->vals[i] = v; return; }
+        i = (i + 1) & m->mask;
+    }
+    m->keys[i] = p;
+    m->vals[i] = v;
+    m->count++;
+}
+
+// Remove page p. Later entries in the same probe run are shifted back
+// into the hole (no tombstones), so lookups stay short after millions
+// of evictions.
+static void pmap_remove(struct PageMap *m, page_t p) {
+    size_t i = pmap_slot(m, p);
+    while (m->keys[i] != p) {
+        if (m->keys[i] == NO_PAGE) return;
+        i = (i + 1) & m->mask;
+    }
+
+    size_t j = i;
+    for (;;) {
+        j = (j + 1) & m->mask;
+        if (m->keys[j] == NO_PAGE) break;
+        // The entry at j may move into the hole at i only if its home
+        // slot is not between i and j (going round the table)
+        size_t home = pmap_slot(m, m->keys[j]);
+        if (((j - home) & m->mask) >= ((j - i) & m->mask)) {
+            m->keys[i] = m->keys[j];
+            m->vals[i] = m->vals[j];
+            i = j;
+        }
+    }
+    m->keys[i] = NO_PAGE;
+    m->count--;
+}
+
+// ----------------------------------------------------------------
+// Frame lookup kernels: "is this page in frame[0..n-1]?"
+// ----------------------------------------------------------------
+
+// The textbook simulators keep their frames in a flat array and scan it
+// on every reference. These kernels do that scan with SIMD compares.
+// Each returns the index of 'page' in frame[], or -1.
+//
+// The engines in sections 1-6 keep using the PageMap: 'pagesim
+// bench-lookup' shows the hash at ~3 ns per lookup for any frame count,
+// while even the AVX2 scan is ~3 ns at 16 frames and grows linearly
+// from there.
+//
+// The SSE4.1 and AVX2 versions are compiled with target attributes and
+// chosen at run time (pick_frame_find()), so one binary runs everywhere;
+// other CPUs get the scalar loop.
+
+static int find_scalar(const page_t *frame, int n, page_t page) {
+    for (int j = 0; j < n; j++) {
+        if (frame[j] == page) return j;
+    }
+    return -1;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+
+// 4 pages per step: two 128-bit compares, one combined bit mask
+__attribute__((target("sse4.1")))
+static int find_sse4(const page_t *frame, int n, page_t page) {
+    __m128i key = _mm_set1_epi64x((long long)page);
+    int j = 0;
+    for (; j + 4 <= n; j += 4) {
+        __m128i a = _mm_cmpeq_epi64(_mm_loadu_si128((const __m128i *)(frame + j)), key);
+        __m128i b = _mm_cmpeq_epi64(_mm_loadu_si128((const __m128i *)(frame + j + 2)), key);
+        int mask = _mm_movemask_pd(_mm_castsi128_pd(a)) |
+                   _mm_movemask_pd(_mm_castsi128_pd(b)) << 2;
+        if (mask) return j + __builtin_ctz(mask);
+    }
+    for (; j < n; j++) {
+        if (frame[j] == page) return j;
+    }
+    return -1;
+}
+
+// 16 pages per step: four 256-bit compares folded into one test, so
+// there is one (well predicted) branch per 128 bytes
+__attribute__((target("avx2")))
+static int find_avx2(const page_t *frame, int n, page_t page) {
+    __m256i key = _mm256_set1_epi64x((long long)page);
+    int j = 0;
+    for (; j + 16 <= n; j += 16) {
+        __m256i a = _mm256_cmpeq_epi64(_mm256_loadu_si256((const __m256i *)(frame + j)), key);
+        __m256i b = _mm256_cmpeq_epi64(_mm256_loadu_si256((const __m256i *)(frame + j + 4)), key);
+        __m256i c = _mm256_cmpeq_epi64(_mm256_loadu_si256((const __m256i *)(frame + j + 8)), key);
+        __m256i d = _mm256_cmpeq_epi64(_mm256_loadu_si256((const __m256i *)(frame + j + 12)), key);
+        __m256i any = _mm256_or_si256(_mm256_or_si256(a, b), _mm256_or_si256(c, d));
+        if (!_mm256_testz_si256(any, any)) {
+            int mask = _mm256_movemask_pd(_mm256_castsi256_pd(a)) |
+                       _mm256_movemask_pd(_mm256_castsi256_pd(b)) << 4 |
+                       _mm256_movemask_pd(_mm256_castsi256_pd(c)) << 8 |
+                       _mm256_movemask_pd(_mm256_castsi256_pd(d)) << 12;
+            return j + __builtin_ctz(mask);
+        }
+    }
+    for (; j + 4 <= n; j += 4) {
+        __m256i a = _mm256_cmpeq_epi64(_mm256_loadu_si256((const __m256i *)(frame + j)), key);
+        int mask = _mm256_movemask_pd(_mm256_castsi256_pd(a));
+        if (mask) return j + __builtin_ctz(mask);
+    }
+    for (; j < n; j++) {
+        if (frame[j] == page) return j;
+    }
+    return -1;
+}
+#endif
+
+typedef int (*frame_find_fn)(const page_t *frame, int n, page_t page);
+
+static frame_find_fn frame_find = find_scalar;
+static const char *frame_find_name = "scalar";
+
+// Use the widest kernel this CPU supports
+static void pick_frame_find(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        frame_find = find_avx2;
+        frame_find_name = "avx2";
+    } else if (__builtin_cpu_supports("sse4.1")) {
+        frame_find = find_sse4;
+        frame_find_name = "sse4.1";
+    }
+#endif
+}
+
+// ----------------------------------------------------------------
+// Reference string input
+// ----------------------------------------------------------------
+
+// Traces come in two kinds:
+//   - text: page numbers separated by whitespace (small hand-made tests)
+//   - binary: a 16-byte header followed by the page numbers, stored as
+//       raw32  4-byte little-endian page numbers
+//       raw64  8-byte little-endian page numbers
+//       delta  each page as the zigzag-encoded difference from the
+//              previous page, written as a varint (1-2 bytes for most
+//              references in a trace with locality)
+//
+// Binary traces are mmapped (or read in fixed-size pieces with '-s')
+// and handed to the engines TRACE_CHUNK pages at a time through a
+// TraceCursor, so a multi-gigabyte trace is never copied onto the heap.
+// 'pagesim convert' writes binary traces.
+
+#define TRACE_MAGIC  "PGTR"
+#define TRACE_CHUNK  4096           // pages handed out per cursor_next()
+#define TRACE_BUF    (1 << 16)      // bytes per read when streaming
+
+enum { TRACE_RAW32 = 1, TRACE_RAW64 = 2, TRACE_DELTA = 3 };
+
+struct TraceHeader {
+    char     magic[4];
+    uint32_t format;
+    uint64_t count;       // number of references
+};
+
+struct Trace {
+    int      format;
+    int64_t  count;
+    const uint8_t *body;  // the encoded pages, or NULL when streaming
+    size_t   body_size;
+    void    *map;         // mmap()ed file (to unmap when done)
+    size_t   map_size;
+    page_t  *owned;       // pages we had to read into memory (text files)
+    const char *path;     // streaming cursors reopen the file
+    int64_t *next_use;    // OPT's next-use array, if built in advance
+};
+
+static page_t default_pages[] = {7,0,1,2,0,3,0,4,2,3};
+
+// Read whitespace-separated page numbers from a text file
+static page_t *load_text_trace(const char *path, int64_t *n_out) {
+    FILE *f = fopen(path, "r");
+    if (f == NULL) die("cannot open trace file");
+
+    size_t cap = 1024, n = 0;
+    page_t *pages = xmalloc(cap * sizeof(page_t));
+    unsigned long long p;
+    while (fscanf(f, "%llu", &p) == 1) {
+        if (n == cap) {
+            cap *= 2;
+            pages = realloc(pages, cap * sizeof(page_t));
+            if (pages == NULL) die("out of memory");
+        }
+        pages[n++] = (page_t)p;
+    }
+    fclose(f);
+
+    *n_out = (int64_t)n;
+    return pages;
+}
+
+// Wrap pages already in memory as a raw64 trace
+static void trace_from_memory(struct Trace *t, const page_t *pages, int64_t n) {
+    memset(t, 0, sizeof(*t));
+    t->format = TRACE_RAW64;
+    t->count = n;
+    t->body = (const uint8_t *)pages;
+    t->body_size = n * sizeof(page_t);
+}
+
+// Open a trace file. Binary traces are mmapped unless 'stream' is set
+// (or the file cannot be mapped); text traces are read into memory.
+static void trace_open(struct Trace *t, const char *path, int stream) {
+    memset(t, 0, sizeof(*t));
+    t->path = path;
+
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) die("cannot open trace file");
+    struct TraceHeader hdr;
+    int binary = fread(&hdr, sizeof(hdr), 1, f) == 1 &&
+                 memcmp(hdr.magic, TRACE_MAGIC, 4) == 0;
+    struct stat st;
+    if (fstat(fileno(f), &st) != 0) die("cannot stat trace file");
+    fclose(f);
+
+    if (!binary) {
+        int64_t n;
+        page_t *pages = load_text_trace(path, &n);
+        trace_from_memory(t, pages, n);
+        t->owned = pages;
+        return;
+    }
+    if (hdr.format < TRACE_RAW32 || hdr.format > TRACE_DELTA) die("unknown trace format");
+    t->format = (int)hdr.format;
+    t->count = (int64_t)hdr.count;
+    t->body_size = (size_t)st.st_size - sizeof(hdr);
+
+    if (!stream) {
+        int fd = open(path, O_RDONLY);
+        if (fd < 0) die("cannot open trace file");
+        void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (map != MAP_FAILED) {
+            madvise(map, st.st_size, MADV_SEQUENTIAL);
+            t->map = map;
+            t->map_size = st.st_size;
+            t->body = (const uint8_t *)map + sizeof(hdr);
+        }
+    }
+}
+
+static void trace_close(struct Trace *t) {
+    if (t->map != NULL) munmap(t->map, t->map_size);
+    free(t->owned);
+    free(t->next_use);
+}
+
+// A read position in a trace. Several cursors can walk the same Trace
+// at once; each streaming cursor has its own FILE and buffer.
+struct TraceCursor {
+    const struct Trace *t;
+    int64_t  left;           // references not handed out yet
+    const uint8_t *p;        // next undecoded byte
+    const uint8_t *end;      // end of the bytes we have
+    page_t   prev;           // previous page (delta decoding)
+    FILE    *f;              // streaming only
+    uint8_t *buf;            // streaming only
+    page_t   out[TRACE_CHUNK];
+};
+
+static void cursor_open(struct TraceCursor *c, const struct Trace *t) {
+    c->t = t;
+    c->left = t->count;
+    c->prev = 0;
+    c->f = NULL;
+    c->buf = NULL;
+    if (t->body != NULL) {
+        c->p = t->body;
+        c->end = t->body + t->body_size;
+    } else {
+        c->f = fopen(t->path, "rb");
+        if (c->f == NULL || fseek(c->f, sizeof(struct TraceHeader), SEEK_SET) != 0)
+            die("cannot reopen trace file");
+        c->buf = xmalloc(TRACE_BUF);
+        c->p = c->end = c->buf;
+    }
+}
+
+static void cursor_close(struct TraceCursor *c) {
+    if (c->f != NULL) fclose(c->f);
+    free(c->buf);
+}
+
+// Streaming: keep the unread tail and top the buffer up from the file
+static void cursor_refill(struct TraceCursor *c) {
+    size_t keep = c->end - c->p;
+    memmove(c->buf, c->p, keep);
+    keep += fread(c->buf + keep, 1, TRACE_BUF - keep, c->f);
+    c->p = c->buf;
+    c->end = c->buf + keep;
+}
+
+static inline page_t read_varint(struct TraceCursor *c) {
+    uint64_t v = 0;
+    int shift = 0;
+    for (;;) {
+        if (c->p == c->end) die("truncated trace file");
+        uint8_t byte = *c->p++;
+        v |= (uint64_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) return v;
+        shift += 7;
+        if (shift > 63) die("bad varint in trace file");
+    }
+}
+
+// Hand out the next chunk of references. Returns how many pages are in
+// *pages (0 at the end of the trace). The pointer stays valid until the
+// next call.
+static int64_t cursor_next(struct TraceCursor *c, const page_t **pages) {
+    int64_t want = c->left < TRACE_CHUNK ? c->left : TRACE_CHUNK;
+    if (want == 0) return 0;
+    int format = c->t->format;
+
+    // raw64 straight out of the mapping: no decoding, no copy
+    if (format == TRACE_RAW64 && c->f == NULL) {
+        if ((size_t)(c->end - c->p) < want * sizeof(page_t)) die("truncated trace file");
+        *pages = (const page_t *)c->p;
+        c->p += want * sizeof(page_t);
+        c->left -= want;
+        return want;
+    }
+
+    // Largest encoded size of one reference
+    size_t width = format == TRACE_RAW32 ? 4 : format == TRACE_RAW64 ? 8 : 10;
+    for (int64_t k = 0; k < want; k++) {
+        if (c->f != NULL && (size_t)(c->end - c->p) < width) cursor_refill(c);
+
+        if (format == TRACE_DELTA) {
+            uint64_t z = read_varint(c);
+            int64_t delta = (int64_t)(z >> 1) ^ -(int64_t)(z & 1);   // zigzag
+            c->prev += (page_t)delta;
+            c->out[k] = c->prev;
+        } else if (format == TRACE_RAW32) {
+            uint32_t v;
+            if (c->end - c->p < 4) die("truncated trace file");
+            memcpy(&v, c->p, 4);
+            c->p += 4;
+            c->out[k] = v;
+        } else {
+            if (c->end - c->p < 8) die("truncated trace file");
+            memcpy(&c->out[k], c->p, 8);
+            c->p += 8;
+        }
+    }
+    c->left -= want;
+    *pages = c->out;
+    return want;
+}
+
+// Copy a whole trace into memory. Only the textbook checks (-c) need
+// random access, and they only make sense on small traces anyway.
+static page_t *trace_load_all(const struct Trace *t) {
+    page_t *all = xmalloc(t->count * sizeof(page_t));
+    struct TraceCursor c;
+    cursor_open(&c, t);
+    const page_t *chunk;
+    int64_t got, at = 0;
+    while ((got = cursor_next(&c, &chunk)) > 0) {
+        memcpy(all + at, chunk, got * sizeof(page_t));
+        at += got;
+    }
+    cursor_close(&c);
+    return all;
+}
+
+static void put_varint(FILE *out, uint64_t v) {
+    uint8_t bytes[10];
+    int k = 0;
+    while (v >= 0x80) {
+        bytes[k++] = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    bytes[k++] = (uint8_t)v;
+    fwrite(bytes, 1, k, out);
+}
+
+// 'pagesim convert': write any trace out as a binary trace
+static int convert_main(const struct Trace *t, int format, const char *out_path) {
+    FILE *out = fopen(out_path, "wb");
+    if (out == NULL) die("cannot create output file");
+
+    struct TraceHeader hdr;
+    memcpy(hdr.magic, TRACE_MAGIC, 4);
+    hdr.format = (uint32_t)format;
+    hdr.count = (uint64_t)t->count;
+    fwrite(&hdr, sizeof(hdr), 1, out);
+
+    struct TraceCursor c;
+    cursor_open(&c, t);
+    const page_t *chunk;
+    int64_t got;
+    page_t prev = 0;
+    while ((got = cursor_next(&c, &chunk)) > 0) {
+        for (int64_t k = 0; k < got; k++) {
+            page_t p = chunk[k];
+            if (format == TRACE_RAW32) {
+                if (p > UINT32_MAX) die("page number does not fit in raw32");
+                uint32_t v = (uint32_t)p;
+                fwrite(&v, 4, 1, out);
+            } else if (format == TRACE_RAW64) {
+                fwrite(&p, 8, 1, out);
+            } else {
+                int64_t delta = (int64_t)(p - prev);
+                put_varint(out, ((uint64_t)delta << 1) ^ (uint64_t)(delta >> 63));
+                prev = p;
+            }
+        }
+    }
+    cursor_close(&c);
+
+    if (fclose(out) != 0) die("error writing output file");
+    printf("Wrote %lld references to %s\n", (long long)t->count, out_path);
+    return 0;
+}
+
+// ----------------------------------------------------------------
+// Shared building blocks: recency lists and next-use heaps
+// ----------------------------------------------------------------
+
+// The LRU and OPT engines of sections 1 and 2, the pluggable policies
+// of section 4 and the cache sets of section 8 all choose victims with
+// these.
+
+// --- Intrusive doubly-linked lists ---
+// Several lists over nodes 0..n-1 that share one pair of link arrays.
+// List k uses node n+k as its head (sentinel), on[x] says which list x
+// is in (-1 = none) and len[k] counts the nodes in list k. The front of
+// a list is the most recent end.
+struct Links {
+    int *prev;
+    int *next;
+    int *on;
+    int64_t *len;
+    int  n;
+};
+
+static void links_init(struct Links *l, int n, int lists) {
+    l->prev = xmalloc((n + lists) * sizeof(int));
+    l->next = xmalloc((n + lists) * sizeof(int));
+    l->on = xmalloc(n * sizeof(int));
+    l->len = calloc(lists, sizeof(int64_t));
+    if (l->len == NULL) die("out of memory");
+    l->n = n;
+    for (int x = 0; x < n; x++) l->on[x] = -1;
+    for (int k = 0; k < lists; k++) l->prev[n + k] = l->next[n + k] = n + k;
+}
+
+static void links_free(struct Links *l) {
+    free(l->prev);
+    free(l->next);
+    free(l->on);
+    free(l->len);
+}
+
+// Insert x after node 'at' (which may be a list head) in list k
+static inline void link_after(struct Links *l, int k, int at, int x) {
+    l->prev[x] = at;
+    l->next[x] = l->next[at];
+    l->prev[l->next[at]] = x;
+    l->next[at] = x;
+    l->on[x] = k;
+    l->len[k]++;
+}
+
+static inline void link_push_front(struct Links *l, int k, int x) {
+    link_after(l, k, l->n + k, x);
+}
+
+static inline void link_push_back(struct Links *l, int k, int x) {
+    link_after(l, k, l->prev[l->n + k], x);
+}
+
+static inline void link_remove(struct Links *l, int x) {
+    if (l->on[x] < 0) return;
+    l->next[l->prev[x]] = l->next[x];
+    l->prev[l->next[x]] = l->prev[x];
+    l->len[l->on[x]]--;
+    l->on[x] = -1;
+}
+
+// Least recent node of list k, or -1 if it is empty
+static inline int link_back(const struct Links *l, int k) {
+    int x = l->prev[l->n + k];
+    return x >= l->n ? -1 : x;
+}
+
+// --- LRU order ---
+// A used node moves to the front of its list; the least recently used
+// is the back (link_back()).
+static inline void lru_touch(struct Links *l, int k, int x) {
+    link_remove(l, x);
+    link_push_front(l, k, x);
+}
+
+// --- Next-use max-heap ---
+// Frames keyed by the next use of the page in them; the root is the
+// frame whose page is used farthest in the future, OPT's victim. The
+// heap works on arrays owned by the caller, so the cache simulator can
+// keep one heap per set in flat arrays and point a NextUseHeap at the
+// set it is working on.
+struct NextUseHeap {
+    int64_t *key;      // key[frame] = next use of the page in it
+    int     *heap;     // frames, farthest next use first
+    int     *hpos;     // hpos[frame] = index in heap[], -1 if absent
+    int      size;
+};
+
+static void nuheap_swap(struct NextUseHeap *h, int a, int b) {
+    int fa = h->heap[a], fb = h->heap[b];
+    h->heap[a] = fb; h->hpos[fb] = a;
+    h->heap[b] = fa; h->hpos[fa] = b;
+}
+
+// Restore heap order around index x after key[heap[x]] changed
+static void nuheap_fix(struct NextUseHeap *h, int x) {
+    while (x > 0 && h->key[h->heap[(x - 1) / 2]] < h->key[h->heap[x]]) {
+        nuheap_swap(h, x, (x - 1) / 2);
+        x = (x - 1) / 2;
+    }
+    for (;;) {
+        int child = 2 * x + 1;
+        if (child >= h->size) break;
+        if (child + 1 < h->size && h->key[h->heap[child + 1]] > h->key[h->heap[child]]) child++;
+        if (h->key[h->heap[child]] <= h->key[h->heap[x]]) break;
+        nuheap_swap(h, x, child);
+        x = child;
+    }
+}
+
+// Frame f now holds a page next used at 'next'; adds f if it is new
+static void nuheap_set(struct NextUseHeap *h, int f, int64_t next) {
+    if (h->hpos[f] < 0) {
+        h->heap[h->size] = f;
+        h->hpos[f] = h->size++;
+    }
+    h->key[f] = next;
+    nuheap_fix(h, h->hpos[f]);
+}
+
+// ----------------------------------------------------------------
+// 1. OPT (Belady) in O(log frames) per reference
+// ----------------------------------------------------------------
+
+// --- Step 1: next-use array ---
+// next_use[i] = index of the next reference to pages[i], or n if the
+// page is never used again. One forward pass with a page map that
+// remembers where each page was last seen. Being a forward pass, it
+// works on streamed and delta-encoded traces too. Pages are compared
+// after a right shift by 'shift': the cache simulator (section 8) passes
+// log2(line size) to get the next use of each cache line, the paging
+// engines pass 0.
+//
+// The pass is fed one reference at a time, so the cache simulator can
+// also build it over a stream it produces itself (the misses of the
+// level above) without storing the stream.
+struct NextUseBuilder {
+    struct PageMap last;
+    int64_t *next_use;
+    int64_t  n;
+    int64_t  cap;
+    int      shift;
+};
+
+static void nub_init(struct NextUseBuilder *b, int shift, int64_t expected) {
+    pmap_init(&b->last, 1024);
+    b->cap = expected > 0 ? expected : 4096;
+    b->next_use = xmalloc(b->cap * sizeof(int64_t));
+    b->n = 0;
+    b->shift = shift;
+}
+
+static inline void nub_push(struct NextUseBuilder *b, page_t page) {
+    if (b->n == b->cap) {
+        b->cap *= 2;
+        b->next_use = realloc(b->next_use, b->cap * sizeof(int64_t));
+        if (b->next_use == NULL) die("out of memory");
+    }
+    int64_t i = b->n++;
+    page_t key = page >> b->shift;
+    int64_t *prev = pmap_find(&b->last, key);
+    if (prev != NULL) {
+        b->next_use[*prev] = i;
+        *prev = i;
+    } else {
+        pmap_put(&b->last, key, i);
+    }
+}
+
+// The last reference to each page is never followed: it gets n
+static int64_t *nub_finish(struct NextUseBuilder *b) {
+    for (size_t k = 0; k <= b->last.mask; k++) {
+        if (b->last.keys[k] != NO_PAGE) b->next_use[b->last.vals[k]] = b->n;
+    }
+    pmap_free(&b->last);
+    return b->next_use;
+}
+
+static int64_t *build_next_use(const struct Trace *t, int shift) {
+    struct NextUseBuilder b;
+    nub_init(&b, shift, t->count);
+
+    struct TraceCursor c;
+    cursor_open(&c, t);
+    const page_t *chunk;
+    int64_t got;
+    while ((got = cursor_next(&c, &chunk)) > 0) {
+        for (int64_t k = 0; k < got; k++) nub_push(&b, chunk[k]);
+    }
+    cursor_close(&c);
+
+    return nub_finish(&b);
+}
+
+// --- Step 2: resident pages in a max-heap keyed by next use ---
+// The frames sit in a NextUseHeap, so the root is always the page used
+// farthest in the future, which is exactly the page the textbook OPT
+// loop searches for.
+//
+// A resident page's key is the index of its next reference, so when we
+// reach reference i the page is a hit exactly when some frame has key
+// i. at[i] remembers which frame that is (-1 = none), so hit detection
+// needs no search and no hashing.
+struct OptSim {
+    int      frames;
+    int      used;       // how many frames are filled
+    struct NextUseHeap h;
+    int     *at;         // at[k] = frame whose key is k
+    const int64_t *next_use;
+    int64_t  n;
+};
+
+static void opt_init(struct OptSim *o, int frames, const int64_t *next_use, int64_t n) {
+    o->frames = frames;
+    o->used = 0;
+    o->h.key = xmalloc(frames * sizeof(int64_t));
+    o->h.heap = xmalloc(frames * sizeof(int));
+    o->h.hpos = xmalloc(frames * sizeof(int));
+    for (int f = 0; f < frames; f++) o->h.hpos[f] = -1;
+    o->h.size = 0;
+    o->at = xmalloc(n * sizeof(int));
+    for (int64_t i = 0; i < n; i++) o->at[i] = -1;
+    o->next_use = next_use;
+    o->n = n;
+}
+
+static void opt_free(struct OptSim *o) {
+    free(o->h.key);
+    free(o->h.heap);
+    free(o->h.hpos);
+    free(o->at);
+}
+
+// Process reference i. Returns 1 on a hit, 0 on a page fault.
+// Keys >= n mean "never used again" and are never looked up.
+static int opt_access(struct OptSim *o, int64_t i) {
+    int64_t next = o->next_use[i];
+    int f = o->at[i];
+    int hit = f >= 0;
+
+    if (hit) {
+        // The page now waits for its *next* reference, which is
+        // further away, so its key grows and it moves up the heap.
+        o->at[i] = -1;
+    } else if (o->used < o->frames) {
+        f = o->used++;                          // fill an empty frame
+    } else {
+        f = o->h.heap[0];                       // used farthest in the future
+        if (o->h.key[f] < o->n) o->at[o->h.key[f]] = -1;
+    }
+    nuheap_set(&o->h, f, next);
+    if (next < o->n) o->at[next] = f;
+    return hit;
+}
+
+static int64_t run_opt(const struct Trace *t, int frames) {
+    int64_t *next_use = build_next_use(t, 0);
+    struct OptSim o;
+    opt_init(&o, frames, next_use, t->count);
+
+    // next_use[] is all the second pass needs, not the pages themselves
+    int64_t faults = 0;
+    for (int64_t i = 0; i < t->count; i++) {
+        if (!opt_access(&o, i)) faults++;
+    }
+
+    opt_free(&o);
+    free(next_use);
+    return faults;
+}
+
+// The textbook OPT from the top of this file, kept as a function so
+// '-c' can check that the fast engine gives the same answer.
+static int64_t run_opt_textbook(const page_t *pages, int64_t n, int frames) {
+    page_t *frame = xmalloc(frames * sizeof(page_t));
+    for (int j = 0; j < frames; j++) frame[j] = NO_PAGE;
+
+    int64_t faults = 0;
+    for (int64_t i = 0; i < n; i++) {
+        if (frame_find(frame, frames, pages[i]) >= 0) continue;
+        faults++;
+
+        // look for an empty frame (they hold NO_PAGE)
+        int index = frame_find(frame, frames, NO_PAGE);
+        if (index == -1) {
+            int64_t farthest = -1;
+            for (int j = 0; j < frames; j++) {
+                int64_t nextuse = -1;
+                for (int64_t k = i + 1; k < n; k++) {
+                    if (frame[j] == pages[k]) { nextuse = k; break; }
+                }
+                if (nextuse == -1) { index = j; break; }
+                if (nextuse > farthest) { farthest = nextuse; index = j; }
+            }
+        }
+        frame[index] = pages[i];
+    }
+
+    free(frame);
+    return faults;
+}
+
+// ----------------------------------------------------------------
+// 2. LRU in O(1) per reference
+// ----------------------------------------------------------------
+
+// Frames are nodes in a doubly-linked recency list (most recent at the
+// front, a Links list from the shared building blocks) and the page map
+// gives page -> node, so a hit, a miss and an eviction are each a hash
+// lookup plus a few pointer updates.
+//
+// All nodes come from one pool allocated up front, and the page map is
+// sized for 'frames' pages, so the loop below never calls malloc.
+struct LruSim {
+    int     frames;
+    int     used;
+    page_t *page;      // page held by each node
+    struct Links l;
+    struct PageMap map;
+};
+
+static void lru_init(struct LruSim *l, int frames) {
+    l->frames = frames;
+    l->used = 0;
+    l->page = xmalloc(frames * sizeof(page_t));
+    links_init(&l->l, frames, 1);
+    pmap_init(&l->map, frames);
+}
+
+static void lru_free(struct LruSim *l) {
+    free(l->page);
+    links_free(&l->l);
+    pmap_free(&l->map);
+}
+
+// Process one reference. Returns 1 on a hit, 0 on a page fault.
+static int lru_access(struct LruSim *l, page_t page) {
+    int64_t *slot = pmap_find(&l->map, page);
+    if (slot != NULL) {
+        lru_touch(&l->l, 0, (int)*slot);
+        return 1;
+    }
+
+    int x;
+    if (l->used < l->frames) {
+        x = l->used++;                       // take a fresh node
+    } else {
+        x = link_back(&l->l, 0);             // least recently used
+        pmap_remove(&l->map, l->page[x]);
+    }
+    l->page[x] = page;
+    pmap_put(&l->map, page, x);
+    lru_touch(&l->l, 0, x);
+    return 0;
+}
+
+static int64_t run_lru(const struct Trace *t, int frames) {
+    struct LruSim l;
+    lru_init(&l, frames);
+
+    struct TraceCursor c;
+    cursor_open(&c, t);
+    const page_t *chunk;
+    int64_t got, faults = 0;
+    while ((got = cursor_next(&c, &chunk)) > 0) {
+        for (int64_t k = 0; k < got; k++) {
+            if (!lru_access(&l, chunk[k])) faults++;
+        }
+    }
+    cursor_close(&c);
+
+    lru_free(&l);
+    return faults;
+}
+
+// The textbook LRU (linear scans over frame[] and lastUsed[])
+static int64_t run_lru_textbook(const page_t *pages, int64_t n, int frames) {
+    page_t *frame = xmalloc(frames * sizeof(page_t));
+    int64_t *lastUsed = xmalloc(frames * sizeof(int64_t));
+    for (int j = 0; j < frames; j++) {
+        frame[j] = NO_PAGE;
+        lastUsed[j] = -1;
+    }
+
+    int64_t faults = 0;
+    for (int64_t i = 0; i < n; i++) {
+        int hit = frame_find(frame, frames, pages[i]);
+        if (hit >= 0) {
+            lastUsed[hit] = i;
+            continue;
+        }
+        faults++;
+
+        int index = frame_find(frame, frames, NO_PAGE);
+        if (index == -1) {
+            index = 0;
+            for (int j = 1; j < frames; j++) {
+                if (lastUsed[j] < lastUsed[index]) index = j;
+            }
+        }
+        frame[index] = pages[i];
+        lastUsed[index] = i;
+    }
+
+    free(frame);
+    free(lastUsed);
+    return faults;
+}
+
+// ----------------------------------------------------------------
+// 3. Stack distances (Mattson): faults for every frame count at once
+// ----------------------------------------------------------------
+
+// LRU has the "stack property": the pages held with F frames are always
+// a subset of the pages held with F+1 frames. So if we know, for each
+// reference, how many distinct pages were touched since the last time
+// this page was used (its stack distance d), then the reference is a
+// hit for every F >= d and a fault for every F < d. One pass that
+// counts how often each distance occurs gives the whole miss-ratio
+// curve.
+//
+// To find d quickly we mark, in a Fenwick tree over positions, the most
+// recent position of every page. The distance of reference i to the
+// page's previous position j is the number of marks in (j, i), plus 1
+// for the page itself. Each step is O(log n).
+
+// Fenwick (binary indexed) tree over positions 0..n-1
+struct Fenwick {
+    int32_t *t;
+    int64_t  n;
+};
+
+static void fen_init(struct Fenwick *f, int64_t n) {
+    f->t = calloc(n + 1, sizeof(int32_t));
+    if (f->t == NULL) die("out of memory");
+    f->n = n;
+}
+
+static inline void fen_add(struct Fenwick *f, int64_t pos, int32_t delta) {
+    for (int64_t i = pos + 1; i <= f->n; i += i & -i) f->t[i] += delta;
+}
+
+// Sum of marks at positions 0..pos-1
+static inline int64_t fen_prefix(const struct Fenwick *f, int64_t pos) {
+    int64_t sum = 0;
+    for (int64_t i = pos; i > 0; i -= i & -i) sum += f->t[i];
+    return sum;
+}
+
+struct StackHist {
+    int64_t *count;     // count[d] = references with stack distance d
+    int64_t  max_d;     // largest distance seen (= distinct pages)
+    int64_t  cap;       // size of count[] - 1
+    int64_t  cold;      // first references (infinite distance)
+    int64_t  refs;
+};
+
+static void stack_hist_free(struct StackHist *h) {
+    free(h->count);
+}
+
+static void stack_hist_init(struct StackHist *h) {
+    h->cap = 1024;
+    h->count = calloc(h->cap + 1, sizeof(int64_t));
+    if (h->count == NULL) die("out of memory");
+    h->max_d = 0;
+    h->cold = 0;
+    h->refs = 0;
+}
+
+// Count one reference with stack distance d
+static inline void stack_hist_add(struct StackHist *h, int64_t d) {
+    if (d > h->cap) {
+        int64_t old = h->cap;
+        while (h->cap < d) h->cap *= 2;
+        h->count = realloc(h->count, (h->cap + 1) * sizeof(int64_t));
+        if (h->count == NULL) die("out of memory");
+        memset(h->count + old + 1, 0, (h->cap - old) * sizeof(int64_t));
+    }
+    if (d > h->max_d) h->max_d = d;
+    h->count[d]++;
+}
+
+static void stack_distances(const struct Trace *t, struct StackHist *h) {
+    struct Fenwick f;
+    fen_init(&f, t->count);
+    struct PageMap last;
+    pmap_init(&last, 1024);
+    stack_hist_init(h);
+    h->refs = t->count;
+
+    struct TraceCursor c;
+    cursor_open(&c, t);
+    const page_t *chunk;
+    int64_t got, i = 0;
+    while ((got = cursor_next(&c, &chunk)) > 0) {
+        for (int64_t k = 0; k < got; k++, i++) {
+            int64_t *prev = pmap_find(&last, chunk[k]);
+            if (prev == NULL) {
+                // Never seen before: a fault for every frame count
+                h->cold++;
+                pmap_put(&last, chunk[k], i);
+            } else {
+                int64_t j = *prev;
+                stack_hist_add(h, fen_prefix(&f, i) - fen_prefix(&f, j + 1) + 1);
+                fen_add(&f, j, -1);
+                *prev = i;
+            }
+            fen_add(&f, i, 1);
+        }
+    }
+    cursor_close(&c);
+
+    pmap_free(&last);
+    free(f.t);
+}
+
+// faults[F] for F = 1..max_frames (faults[0] is unused)
+static int64_t *stack_hist_faults(const struct StackHist *h, int64_t max_frames) {
+    int64_t *faults = xmalloc((max_frames + 1) * sizeof(int64_t));
+
+    // Faults with F frames = cold misses + references with distance > F
+    int64_t beyond = 0;
+    for (int64_t d = h->max_d; d > max_frames; d--) beyond += h->count[d];
+    for (int64_t F = max_frames; F >= 1; F--) {
+        faults[F] = h->cold + beyond;
+        if (F <= h->max_d) beyond += h->count[F];
+    }
+    faults[0] = h->refs;
+    return faults;
+}
+
+// 'pagesim mrc': print the miss-ratio curve for 1..max_frames frames
+static int mrc_main(const struct Trace *t, int max_frames, int check) {
+    int64_t n = t->count;
+    double start = now_sec();
+    struct StackHist h;
+    stack_distances(t, &h);
+    double elapsed = now_sec() - start;
+
+    // By default stop where only first-use faults are left
+    int64_t upto = max_frames > 0 ? max_frames : (h.max_d > 0 ? h.max_d : 1);
+    int64_t *faults = stack_hist_faults(&h, upto);
+
+    printf("Policy: LRU (stack distance)   References: %lld   Distinct Pages: %lld\n",
+           (long long)n, (long long)h.cold);
+    printf("%-12s%-16s%s\n", "Frames", "Page Faults", "Miss Ratio");
+    printf("------------------------------------------------\n");
+    for (int64_t F = 1; F <= upto; F++) {
+        printf("%-12lld%-16lld%.6f\n", (long long)F, (long long)faults[F],
+               n ? (double)faults[F] / n : 0.0);
+    }
+    printf("------------------------------------------------\n");
+    printf("Time: %.3f s (%.1f ns/ref)\n", elapsed, n ? elapsed * 1e9 / n : 0.0);
+
+    int status = 0;
+    if (check) {
+        // Rerun the O(1) LRU once per frame count and compare
+        int64_t bad = 0;
+        for (int64_t F = 1; F <= upto; F++) {
+            if (run_lru(t, (int)F) != faults[F]) bad++;
+        }
+        printf("Checked against LRU for %lld frame counts: %s\n", (long long)upto,
+               bad ? "MISMATCH" : "match");
+        status = bad ? 1 : 0;
+    }
+
+    free(faults);
+    stack_hist_free(&h);
+    return status;
+}
+
+// ----------------------------------------------------------------
+// 4. Pluggable replacement policies
+// ----------------------------------------------------------------
+
+// Every policy below plugs into the same loop. The frame table (shared
+// by all of them) owns "which page is in which frame" and the page ->
+// frame hash lookup; a policy only keeps its own bookkeeping and answers
+// three questions through callbacks:
+//
+//   hit(frame)          the page in 'frame' was referenced again
+//   evict(page)         memory is full and 'page' is coming in - which
+//                       frame should be given up?
+//   insert(frame, page) 'page' was just loaded into 'frame'
+//
+// Policies that remember pages after evicting them (ARC, 2Q, LIRS,
+// CLOCK-Pro) keep those "ghost" entries in their own structures.
+// Every policy here costs O(1) amortized per reference (OPT: O(log F)),
+// except the tick-based ones (Aging, NFU, WSClock): a fault costs one
+// pass over F/64 words per counter bit, and so does each clock tick.
+
+struct FrameTable {
+    int      frames;
+    int      used;
+    page_t  *page;          // page held by each frame
+    struct PageMap map;     // page -> frame
+};
+
+struct PolicyOps {
+    const char *name;
+    void *(*create)(const struct FrameTable *ft, const struct Trace *t);
+    void  (*destroy)(void *s);
+    void  (*hit)(void *s, int frame, int64_t i);
+    int   (*evict)(void *s, page_t page, int64_t i);
+    void  (*insert)(void *s, int frame, page_t page, int64_t i);
+    int   ticks;        // tick-based: a fault costs a pass over the frames
+};
+
+static int64_t run_policy(const struct PolicyOps *ops, const struct Trace *t, int frames) {
+    struct FrameTable ft;
+    ft.frames = frames;
+    ft.used = 0;
+    ft.page = xmalloc(frames * sizeof(page_t));
+    pmap_init(&ft.map, frames);
+    void *s = ops->create(&ft, t);
+
+    struct TraceCursor c;
+    cursor_open(&c, t);
+    const page_t *chunk;
+    int64_t got, i = 0, faults = 0;
+    while ((got = cursor_next(&c, &chunk)) > 0) {
+        for (int64_t k = 0; k < got; k++, i++) {
+            page_t page = chunk[k];
+            int64_t *slot = pmap_find(&ft.map, page);
+            if (slot != NULL) {
+                ops->hit(s, (int)*slot, i);
+                continue;
+            }
+
+            faults++;
+            int f;
+            if (ft.used < ft.frames) {
+                f = ft.used++;
+            } else {
+                f = ops->evict(s, page, i);
+                pmap_remove(&ft.map, ft.page[f]);
+            }
+            ft.page[f] = page;
+            pmap_put(&ft.map, page, f);
+            ops->insert(s, f, page, i);
+        }
+    }
+    cursor_close(&c);
+
+    ops->destroy(s);
+    pmap_free(&ft.map);
+    free(ft.page);
+    return faults;
+}
+
+// --- Shared building block: ghost entries ---
+// Evicted pages that a policy still wants to remember. Ghost g lives in
+// one of the policy's ghost lists, and 'map' finds a ghost by page.
+// Free ghosts wait on list GHOST_FREE.
+#define GHOST_FREE 0
+
+struct Ghosts {
+    struct Links l;
+    page_t *page;
+    struct PageMap map;
+};
+
+static void ghosts_init(struct Ghosts *g, int count, int lists) {
+    links_init(&g->l, count, lists);
+    g->page = xmalloc(count * sizeof(page_t));
+    pmap_init(&g->map, count);
+    for (int x = 0; x < count; x++) link_push_back(&g->l, GHOST_FREE, x);
+}
+
+static void ghosts_free(struct Ghosts *g) {
+    links_free(&g->l);
+    free(g->page);
+    pmap_free(&g->map);
+}
+
+// Ghost holding 'page', or -1
+static inline int ghost_find(struct Ghosts *g, page_t page) {
+    int64_t *slot = pmap_find(&g->map, page);
+    return slot ? (int)*slot : -1;
+}
+
+// Remember 'page' at the front of ghost list k
+static inline int ghost_add(struct Ghosts *g, int k, page_t page) {
+    int x = link_back(&g->l, GHOST_FREE);
+    if (x < 0) die("ghost pool exhausted");
+    link_remove(&g->l, x);
+    link_push_front(&g->l, k, x);
+    g->page[x] = page;
+    pmap_put(&g->map, page, x);
+    return x;
+}
+
+static inline void ghost_drop(struct Ghosts *g, int x) {
+    pmap_remove(&g->map, g->page[x]);
+    link_remove(&g->l, x);
+    link_push_back(&g->l, GHOST_FREE, x);
+}
+
+// --- LRU ---
+// One recency list over the frames (lru_touch() above); the victim is
+// the back.
+struct LruPolicy {
+    struct Links l;
+};
+
+static void *lru_create(const struct FrameTable *ft, const struct Trace *t) {
+    (void)t;
+    struct LruPolicy *s = xmalloc(sizeof(*s));
+    links_init(&s->l, ft->frames, 1);
+    return s;
+}
+
+static void lru_destroy(void *p) {
+    struct LruPolicy *s = p;
+    links_free(&s->l);
+    free(s);
+}
+
+static void lru_hit(void *p, int f, int64_t i) {
+    (void)i;
+    struct LruPolicy *s = p;
+    lru_touch(&s->l, 0, f);
+}
+
+static int lru_evict(void *p, page_t page, int64_t i) {
+    (void)page; (void)i;
+    struct LruPolicy *s = p;
+    return link_back(&s->l, 0);
+}
+
+static void lru_insert(void *p, int f, page_t page, int64_t i) {
+    (void)page;
+    lru_hit(p, f, i);
+}
+
+// --- OPT ---
+// The NextUseHeap of section 1 over the frames, but the hash lookup is
+// done by the frame table. The victim is the root.
+struct OptPolicy {
+    const int64_t *next_use;
+    int64_t *own_next_use;   // built here unless the trace has one
+    struct NextUseHeap h;
+};
+
+static void *opt_create(const struct FrameTable *ft, const struct Trace *t) {
+    struct OptPolicy *s = xmalloc(sizeof(*s));
+    s->own_next_use = t->next_use ? NULL : build_next_use(t, 0);
+    s->next_use = t->next_use ? t->next_use : s->own_next_use;
+    s->h.key = xmalloc(ft->frames * sizeof(int64_t));
+    s->h.heap = xmalloc(ft->frames * sizeof(int));
+    s->h.hpos = xmalloc(ft->frames * sizeof(int));
+    for (int f = 0; f < ft->frames; f++) s->h.hpos[f] = -1;
+    s->h.size = 0;
+    return s;
+}
+
+static void opt_destroy(void *p) {
+    struct OptPolicy *s = p;
+    free(s->own_next_use);
+    free(s->h.key);
+    free(s->h.heap);
+    free(s->h.hpos);
+    free(s);
+}
+
+static void opt_hit(void *p, int f, int64_t i) {
+    struct OptPolicy *s = p;
+    nuheap_set(&s->h, f, s->next_use[i]);
+}
+
+static int opt_evict(void *p, page_t page, int64_t i) {
+    (void)page; (void)i;
+    struct OptPolicy *s = p;
+    return s->h.heap[0];
+}
+
+static void opt_insert(void *p, int f, page_t page, int64_t i) {
+    (void)page;
+    opt_hit(p, f, i);
+}
+
+// --- CLOCK (second chance) ---
+// Frames sit on a circle with a reference bit each. The hand sweeps,
+// clearing set bits, and evicts the first frame whose bit is clear.
+
+// The sweep over ref[0..n-1] from *hand on; leaves the hand just past
+// the victim. The cache simulator (section 8) runs it on each set.
+static inline int clock_sweep(uint8_t *ref, int n, int *hand) {
+    int h = *hand;
+    while (ref[h]) {
+        ref[h] = 0;
+        if (++h == n) h = 0;
+    }
+    *hand = h + 1 == n ? 0 : h + 1;
+    return h;
+}
+
+struct ClockPolicy {
+    uint8_t *ref;
+    int      hand;
+    int      frames;
+};
+
+static void *clock_create(const struct FrameTable *ft, const struct Trace *t) {
+    (void)t;
+    struct ClockPolicy *s = xmalloc(sizeof(*s));
+    s->ref = calloc(ft->frames, 1);
+    if (s->ref == NULL) die("out of memory");
+    s->hand = 0;
+    s->frames = ft->frames;
+    return s;
+}
+
+static void clock_destroy(void *p) {
+    struct ClockPolicy *s = p;
+    free(s->ref);
+    free(s);
+}
+
+static void clock_hit(void *p, int f, int64_t i) {
+    (void)i;
+    ((struct ClockPolicy *)p)->ref[f] = 1;
+}
+
+static int clock_evict(void *p, page_t page, int64_t i) {
+    (void)page; (void)i;
+    struct ClockPolicy *s = p;
+    return clock_sweep(s->ref, s->frames, &s->hand);
+}
+
+static void clock_insert(void *p, int f, page_t page, int64_t i) {
+    (void)page;
+    clock_hit(p, f, i);
+}
+
+// --- 2Q (Johnson & Shasha, full version) ---
+// New pages enter A1in, a FIFO holding about a quarter of memory. Pages
+// pushed out of A1in are remembered (not kept) in the ghost FIFO A1out.
+// A page that comes back while remembered in A1out has proven it is
+// reused, so it goes to Am, which is managed as LRU. One-time scans
+// therefore flow through A1in without disturbing Am.
+enum { Q2_A1IN = 0, Q2_AM = 1 };         // resident lists
+enum { Q2_A1OUT = 1 };                   // ghost list (0 = free)
+
+struct TwoQPolicy {
+    const struct FrameTable *ft;
+    struct Links  res;
+    struct Ghosts ghosts;
+    int64_t kin;        // target size of A1in
+    int64_t kout;       // size of A1out
+};
+
+static void *twoq_create(const struct FrameTable *ft, const struct Trace *t) {
+    (void)t;
+    struct TwoQPolicy *s = xmalloc(sizeof(*s));
+    s->ft = ft;
+    s->kin = ft->frames / 4 > 0 ? ft->frames / 4 : 1;
+    s->kout = ft->frames / 2 > 0 ? ft->frames / 2 : 1;
+    links_init(&s->res, ft->frames, 2);
+    ghosts_init(&s->ghosts, (int)s->kout + 1, 2);
+    return s;
+}
+
+static void twoq_destroy(void *p) {
+    struct TwoQPolicy *s = p;
+    links_free(&s->res);
+    ghosts_free(&s->ghosts);
+    free(s);
+}
+
+static void twoq_hit(void *p, int f, int64_t i) {
+    (void)i;
+    struct TwoQPolicy *s = p;
+    // Hits in A1in do not reorder it: it is a FIFO on purpose
+    if (s->res.on[f] == Q2_AM) {
+        link_remove(&s->res, f);
+        link_push_front(&s->res, Q2_AM, f);
+    }
+}
+
+static int twoq_evict(void *p, page_t page, int64_t i) {
+    (void)page; (void)i;
+    struct TwoQPolicy *s = p;
+    int victim;
+    if (s->res.len[Q2_A1IN] > s->kin || s->res.len[Q2_AM] == 0) {
+        victim = link_back(&s->res, Q2_A1IN);
+        // Remember it in A1out, forgetting the oldest ghost if full
+        if (s->ghosts.l.len[Q2_A1OUT] >= s->kout)
+            ghost_drop(&s->ghosts, link_back(&s->ghosts.l, Q2_A1OUT));
+        ghost_add(&s->ghosts, Q2_A1OUT, s->ft->page[victim]);
+    } else {
+        victim = link_back(&s->res, Q2_AM);
+    }
+    link_remove(&s->res, victim);
+    return victim;
+}
+
+static void twoq_insert(void *p, int f, page_t page, int64_t i) {
+    (void)i;
+    struct TwoQPolicy *s = p;
+    int g = ghost_find(&s->ghosts, page);
+    if (g >= 0) {
+        ghost_drop(&s->ghosts, g);
+        link_push_front(&s->res, Q2_AM, f);
+    } else {
+        link_push_front(&s->res, Q2_A1IN, f);
+    }
+}
+
+// --- ARC (Megiddo & Modha) ---
+// T1 holds pages seen once recently, T2 pages seen at least twice. B1
+// and B2 remember pages recently evicted from T1 and T2. A hit in B1
+// means "T1 was too small", a hit in B2 means "T2 was too small", and
+// the target size p of T1 moves accordingly, so ARC tunes itself between
+// recency and frequency.
+enum { ARC_T1 = 0, ARC_T2 = 1 };         // resident lists
+enum { ARC_B1 = 1, ARC_B2 = 2 };         // ghost lists (0 = free)
+
+struct ArcPolicy {
+    const struct FrameTable *ft;
+    struct Links  res;
+    struct Ghosts ghosts;
+    int64_t c;          // number of frames
+    int64_t p;          // target size of T1
+    int     incoming;   // ghost of the page being loaded, or -1
+};
+
+static void *arc_create(const struct FrameTable *ft, const struct Trace *t) {
+    (void)t;
+    struct ArcPolicy *s = xmalloc(sizeof(*s));
+    s->ft = ft;
+    s->c = ft->frames;
+    s->p = 0;
+    s->incoming = -1;
+    links_init(&s->res, ft->frames, 2);
+    ghosts_init(&s->ghosts, ft->frames + 1, 3);
+    return s;
+}
+
+static void arc_destroy(void *p) {
+    struct ArcPolicy *s = p;
+    links_free(&s->res);
+    ghosts_free(&s->ghosts);
+    free(s);
+}
+
+static void arc_hit(void *p, int f, int64_t i) {
+    (void)i;
+    struct ArcPolicy *s = p;
+    link_remove(&s->res, f);
+    link_push_front(&s->res, ARC_T2, f);
+}
+
+// Move the LRU page of T1 or T2 to its ghost list and return its frame
+static int arc_replace(struct ArcPolicy *s, int in_b2) {
+    int64_t t1 = s->res.len[ARC_T1];
+    int victim;
+    if (t1 > 0 && (t1 > s->p || (in_b2 && t1 == s->p) || s->res.len[ARC_T2] == 0)) {
+        victim = link_back(&s->res, ARC_T1);
+        ghost_add(&s->ghosts, ARC_B1, s->ft->page[victim]);
+    } else {
+        victim = link_back(&s->res, ARC_T2);
+        ghost_add(&s->ghosts, ARC_B2, s->ft->page[victim]);
+    }
+    link_remove(&s->res, victim);
+    return victim;
+}
+
+static int arc_evict(void *p, page_t page, int64_t i) {
+    (void)i;
+    struct ArcPolicy *s = p;
+    struct Links *gl = &s->ghosts.l;
+    int64_t b1 = gl->len[ARC_B1], b2 = gl->len[ARC_B2];
+
+    int g = ghost_find(&s->ghosts, page);
+    s->incoming = g;
+    if (g >= 0 && gl->on[g] == ARC_B1) {
+        // Case II: adapt towards recency
+        int64_t delta = b2 > b1 ? b2 / b1 : 1;
+        s->p = s->p + delta < s->c ? s->p + delta : s->c;
+        return arc_replace(s, 0);
+    }
+    if (g >= 0) {
+        // Case III: adapt towards frequency
+        int64_t delta = b1 > b2 ? b1 / b2 : 1;
+        s->p = s->p - delta > 0 ? s->p - delta : 0;
+        return arc_replace(s, 1);
+    }
+
+    // Case IV: a brand-new page. Keep |T1| + |B1| <= c and the whole
+    // directory <= 2c.
+    int64_t t1 = s->res.len[ARC_T1];
+    if (t1 + b1 >= s->c) {
+        if (t1 < s->c) {
+            ghost_drop(&s->ghosts, link_back(gl, ARC_B1));
+            return arc_replace(s, 0);
+        }
+        // B1 is empty: evict the LRU page of T1 without remembering it
+        int victim = link_back(&s->res, ARC_T1);
+        link_remove(&s->res, victim);
+        return victim;
+    }
+    if (t1 + s->res.len[ARC_T2] + b1 + b2 >= 2 * s->c)
+        ghost_drop(&s->ghosts, link_back(gl, ARC_B2));
+    return arc_replace(s, 0);
+}
+
+static void arc_insert(void *p, int f, page_t page, int64_t i) {
+    (void)i;
+    struct ArcPolicy *s = p;
+    // evict() already looked the page up. While memory is filling up
+    // evict() is not called, but then there are no ghosts yet either.
+    (void)page;
+    int g = s->incoming;
+    s->incoming = -1;
+    if (g >= 0) {
+        ghost_drop(&s->ghosts, g);
+        link_push_front(&s->res, ARC_T2, f);
+    } else {
+        link_push_front(&s->res, ARC_T1, f);
+    }
+}
+
+// --- CLOCK-Pro (Jiang, Chen & Zhang) ---
+// CLOCK with hot/cold pages and a "test period". A new page starts cold
+// and in its test period; if it is referenced again before the test
+// ends it is promoted to hot. Recently evicted cold pages that are
+// still in their test period are kept as non-resident entries, so a
+// quick return is noticed too. Three hands do the work:
+//   hand_cold  finds a cold resident page to evict
+//   hand_hot   demotes hot pages to cold when there are too many hot,
+//              ending the test periods it passes
+//   hand_test  ends test periods to drop non-resident entries
+// The cold target mc grows when a non-resident page in test comes back
+// (cold pages were evicted too early) and shrinks when a test period
+// runs out.
+//
+// In the paper all entries share one circle and hand_cold steps over
+// every hot page, which costs O(F) per eviction once most pages are
+// hot. Here the circle is split in two, both kept in clock order:
+//   hot clock   hot pages and every entry in its test period
+//   cold clock  cold resident pages (a cold page in test is in both)
+// hand_hot and hand_test walk the first, hand_cold the second, so every
+// hand step clears a bit, ends a test, evicts or moves a page, which
+// makes a reference O(1) amortized. A demoted page joins the cold clock
+// at its head rather than at its old position.
+//
+// Nodes 0..F-1 are the frames, F..2F+1 the non-resident entries. Both
+// clocks are list 0 of their Links; the hands follow next[], so a page
+// pushed on the back (the head of the clock) is reached last.
+#define CP_HOT   1
+#define CP_REF   2
+#define CP_TEST  4
+
+struct ClockProPolicy {
+    const struct FrameTable *ft;
+    struct Links hl;        // list 0 = hot clock, list 1 = free ghosts
+    struct Links cl;        // list 0 = cold clock
+    uint8_t *flags;
+    page_t  *ghost_page;    // indexed by node - F
+    struct PageMap ghost_map;
+    int      frames;
+    int      hand_hot, hand_test, hand_cold;
+    int64_t  mc;            // target number of cold resident pages
+    int64_t  hot;           // hot pages
+    int64_t  nonres;        // non-resident entries
+};
+
+static void *clockpro_create(const struct FrameTable *ft, const struct Trace *t) {
+    (void)t;
+    struct ClockProPolicy *s = xmalloc(sizeof(*s));
+    int F = ft->frames;
+    s->ft = ft;
+    s->frames = F;
+    links_init(&s->hl, 2 * F + 2, 2);
+    links_init(&s->cl, F, 1);
+    s->flags = calloc(2 * F + 2, 1);
+    if (s->flags == NULL) die("out of memory");
+    s->ghost_page = xmalloc((F + 2) * sizeof(page_t));
+    pmap_init(&s->ghost_map, F + 2);
+    for (int x = F; x < 2 * F + 2; x++) link_push_back(&s->hl, 1, x);
+    s->hand_hot = s->hand_test = s->hand_cold = -1;
+    s->mc = F / 2 > 0 ? F / 2 : 1;
+    s->hot = 0;
+    s->nonres = 0;
+    return s;
+}
+
+static void clockpro_destroy(void *p) {
+    struct ClockProPolicy *s = p;
+    links_free(&s->hl);
+    links_free(&s->cl);
+    free(s->flags);
+    free(s->ghost_page);
+    pmap_free(&s->ghost_map);
+    free(s);
+}
+
+// Next entry after x on list 0 of l, going round and skipping the head
+static inline int ring_next(const struct Links *l, int x) {
+    x = l->next[x];
+    return x == l->n ? l->next[x] : x;
+}
+
+// Take x off the hot clock / cold clock, moving any hand on it
+static void cp_unlink_hot(struct ClockProPolicy *s, int x) {
+    int after = ring_next(&s->hl, x);
+    if (after == x) after = -1;
+    if (s->hand_hot == x) s->hand_hot = after;
+    if (s->hand_test == x) s->hand_test = after;
+    link_remove(&s->hl, x);
+}
+
+static void cp_unlink_cold(struct ClockProPolicy *s, int x) {
+    int after = ring_next(&s->cl, x);
+    if (after == x) after = -1;
+    if (s->hand_cold == x) s->hand_cold = after;
+    link_remove(&s->cl, x);
+}
+
+// Put x at the head of the hot clock / cold clock
+static void cp_push_hot(struct ClockProPolicy *s, int x) {
+    link_push_back(&s->hl, 0, x);
+    if (s->hand_hot < 0) s->hand_hot = s->hand_test = x;
+}
+
+static void cp_push_cold(struct ClockProPolicy *s, int x) {
+    link_push_back(&s->cl, 0, x);
+    if (s->hand_cold < 0) s->hand_cold = x;
+}
+
+// Forget a non-resident entry
+static void cp_drop_ghost(struct ClockProPolicy *s, int x) {
+    cp_unlink_hot(s, x);
+    pmap_remove(&s->ghost_map, s->ghost_page[x - s->frames]);
+    s->flags[x] = 0;
+    link_push_back(&s->hl, 1, x);
+    s->nonres--;
+}
+
+// End the test period of cold entry x
+static void cp_end_test(struct ClockProPolicy *s, int x) {
+    if (x >= s->frames) {
+        cp_drop_ghost(s, x);
+        if (s->mc > 1) s->mc--;
+    } else {
+        s->flags[x] &= ~CP_TEST;
+        cp_unlink_hot(s, x);
+    }
+}
+
+// Move hand_hot until one hot page has been demoted to cold
+static void cp_run_hand_hot(struct ClockProPolicy *s) {
+    while (s->hot > 0) {
+        int x = s->hand_hot;
+        s->hand_hot = ring_next(&s->hl, x);
+        if (!(s->flags[x] & CP_HOT)) {
+            cp_end_test(s, x);
+        } else if (s->flags[x] & CP_REF) {
+            s->flags[x] &= ~CP_REF;
+        } else {
+            s->flags[x] = 0;
+            s->hot--;
+            cp_unlink_hot(s, x);
+            cp_push_cold(s, x);
+            return;
+        }
+    }
+}
+
+// Move hand_test until one non-resident entry has been dropped
+static void cp_run_hand_test(struct ClockProPolicy *s) {
+    while (s->nonres > 0) {
+        int x = s->hand_test;
+        s->hand_test = ring_next(&s->hl, x);
+        if (!(s->flags[x] & CP_HOT)) {
+            int was_ghost = x >= s->frames;
+            cp_end_test(s, x);
+            if (was_ghost) return;
+        }
+    }
+}
+
+// Make resident page x hot; it must already be on neither clock
+static void cp_promote(struct ClockProPolicy *s, int x) {
+    s->flags[x] = CP_HOT;
+    s->hot++;
+    cp_push_hot(s, x);
+    while (s->hot > s->frames - s->mc) cp_run_hand_hot(s);
+}
+
+static void clockpro_hit(void *p, int f, int64_t i) {
+    (void)i;
+    ((struct ClockProPolicy *)p)->flags[f] |= CP_REF;
+}
+
+static int clockpro_evict(void *p, page_t page, int64_t i) {
+    (void)page; (void)i;
+    struct ClockProPolicy *s = p;
+    // The cold clock is never empty: hot pages are capped at F - mc
+    for (;;) {
+        int x = s->hand_cold;
+        s->hand_cold = ring_next(&s->cl, x);
+
+        if (s->flags[x] & CP_REF) {
+            // Referenced cold page: promote it if it was in its test
+            // period, otherwise give it a test period at the head
+            cp_unlink_cold(s, x);
+            if (s->flags[x] & CP_TEST) {
+                cp_unlink_hot(s, x);
+                cp_promote(s, x);
+            } else {
+                s->flags[x] = CP_TEST;
+                cp_push_cold(s, x);
+                cp_push_hot(s, x);
+            }
+            continue;
+        }
+
+        // Victim. If it is still in its test period, a non-resident
+        // entry takes its place on the hot clock.
+        cp_unlink_cold(s, x);
+        if (s->flags[x] & CP_TEST) {
+            int g = link_back(&s->hl, 1);
+            link_remove(&s->hl, g);
+            link_after(&s->hl, 0, x, g);
+            cp_unlink_hot(s, x);
+            s->flags[g] = CP_TEST;
+            s->ghost_page[g - s->frames] = s->ft->page[x];
+            pmap_put(&s->ghost_map, s->ft->page[x], g);
+            s->nonres++;
+        }
+        s->flags[x] = 0;
+        while (s->nonres > s->frames) cp_run_hand_test(s);
+        return x;
+    }
+}
+
+static void clockpro_insert(void *p, int f, page_t page, int64_t i) {
+    (void)i;
+    struct ClockProPolicy *s = p;
+    int64_t *slot = pmap_find(&s->ghost_map, page);
+    if (slot != NULL) {
+        // Back during its test period: cold pages are being evicted
+        // too soon, so grow the cold target and make this page hot
+        cp_drop_ghost(s, (int)*slot);
+        if (s->mc < s->frames - 1) s->mc++;
+        cp_promote(s, f);
+    } else {
+        s->flags[f] = CP_TEST;
+        cp_push_cold(s, f);
+        cp_push_hot(s, f);
+    }
+}
+
+// --- LIRS (Jiang & Zhang) ---
+// Pages are LIR (low inter-reference recency: hot, always resident) or
+// HIR. Stack S orders entries by recency and always has an LIR page at
+// the bottom; queue Q holds the resident HIR pages, which are the only
+// eviction candidates. An HIR page referenced again while still in S
+// has a shorter reuse distance than the oldest LIR page, so the two
+// swap roles. S also keeps recently evicted HIR pages (as ghosts, at
+// most F of them) so their reuse can be recognised.
+//
+// Nodes 0..F-1 are the frames, F..2F are ghosts. Links 'q' holds Q over
+// the frames plus the ghost FIFO and the free ghosts; the front of Q is
+// its most recent end, so the eviction candidate is at the back.
+enum { LIRS_Q = 0, LIRS_GHOSTS = 1, LIRS_FREE = 2 };
+#define LIRS_LIR 1
+
+struct LirsPolicy {
+    const struct FrameTable *ft;
+    struct Links s;         // stack S (front = top)
+    struct Links q;
+    uint8_t *lir;
+    page_t  *ghost_page;    // indexed by node - F
+    struct PageMap ghost_map;
+    int      frames;
+    int64_t  lir_count;
+    int64_t  lir_max;       // frames reserved for LIR pages
+};
+
+static void *lirs_create(const struct FrameTable *ft, const struct Trace *t) {
+    (void)t;
+    struct LirsPolicy *s = xmalloc(sizeof(*s));
+    int F = ft->frames;
+    s->ft = ft;
+    s->frames = F;
+    links_init(&s->s, 2 * F + 1, 1);
+    links_init(&s->q, 2 * F + 1, 3);
+    s->lir = calloc(2 * F + 1, 1);
+    if (s->lir == NULL) die("out of memory");
+    s->ghost_page = xmalloc((F + 1) * sizeof(page_t));
+    pmap_init(&s->ghost_map, F + 1);
+    for (int x = F; x < 2 * F + 1; x++) link_push_back(&s->q, LIRS_FREE, x);
+    // About 1% of memory for resident HIR pages, as in the paper
+    int64_t hir = F / 100 > 0 ? F / 100 : 1;
+    s->lir_max = F - hir;
+    s->lir_count = 0;
+    return s;
+}
+
+static void lirs_destroy(void *p) {
+    struct LirsPolicy *s = p;
+    links_free(&s->s);
+    links_free(&s->q);
+    free(s->lir);
+    free(s->ghost_page);
+    pmap_free(&s->ghost_map);
+    free(s);
+}
+
+static void lirs_drop_ghost(struct LirsPolicy *s, int g) {
+    link_remove(&s->s, g);
+    link_remove(&s->q, g);
+    pmap_remove(&s->ghost_map, s->ghost_page[g - s->frames]);
+    link_push_back(&s->q, LIRS_FREE, g);
+}
+
+// Pop HIR entries off the bottom of S until an LIR page is at the bottom
+static void lirs_prune(struct LirsPolicy *s) {
+    int x;
+    while ((x = link_back(&s->s, 0)) >= 0 && !s->lir[x]) {
+        if (x < s->frames) link_remove(&s->s, x);
+        else lirs_drop_ghost(s, x);
+    }
+}
+
+// Frame f just became LIR. If that is one LIR page too many, the LIR
+// page at the bottom of S becomes a resident HIR page.
+static void lirs_make_lir(struct LirsPolicy *s, int f) {
+    link_remove(&s->q, f);
+    if (s->lir_max == 0) {
+        // A single frame leaves no room for LIR pages
+        link_push_front(&s->q, LIRS_Q, f);
+        return;
+    }
+    s->lir[f] = LIRS_LIR;
+    if (++s->lir_count > s->lir_max) {
+        int bottom = link_back(&s->s, 0);
+        s->lir[bottom] = 0;
+        s->lir_count--;
+        link_push_front(&s->q, LIRS_Q, bottom);
+    }
+    lirs_prune(s);
+}
+
+static void lirs_hit(void *p, int f, int64_t i) {
+    (void)i;
+    struct LirsPolicy *s = p;
+    int in_s = s->s.on[f] >= 0;
+    link_remove(&s->s, f);
+    link_push_front(&s->s, 0, f);
+
+    if (s->lir[f]) {
+        lirs_prune(s);          // in case f was the bottom
+    } else if (in_s) {
+        lirs_make_lir(s, f);
+    } else {
+        link_remove(&s->q, f);  // stays HIR, moves to the end of Q
+        link_push_front(&s->q, LIRS_Q, f);
+    }
+}
+
+static int lirs_evict(void *p, page_t page, int64_t i) {
+    (void)page; (void)i;
+    struct LirsPolicy *s = p;
+    // Q is never empty here: at most lir_max < F frames hold LIR pages
+    int victim = link_back(&s->q, LIRS_Q);
+    link_remove(&s->q, victim);
+
+    if (s->s.on[victim] >= 0) {
+        // Keep its place in S as a non-resident HIR entry
+        if (s->q.len[LIRS_GHOSTS] >= s->frames)
+            lirs_drop_ghost(s, link_back(&s->q, LIRS_GHOSTS));
+        int g = link_back(&s->q, LIRS_FREE);
+        link_remove(&s->q, g);
+        link_push_front(&s->q, LIRS_GHOSTS, g);
+        link_after(&s->s, 0, victim, g);
+        link_remove(&s->s, victim);
+        s->ghost_page[g - s->frames] = s->ft->page[victim];
+        pmap_put(&s->ghost_map, s->ft->page[victim], g);
+    }
+    return victim;
+}
+
+static void lirs_insert(void *p, int f, page_t page, int64_t i) {
+    (void)i;
+    struct LirsPolicy *s = p;
+    int64_t *slot = pmap_find(&s->ghost_map, page);
+    s->lir[f] = 0;
+    link_push_front(&s->s, 0, f);
+
+    if (slot != NULL) {
+        // Non-resident HIR page still in S: it becomes LIR
+        lirs_drop_ghost(s, (int)*slot);
+        lirs_make_lir(s, f);
+    } else if (s->lir_count < s->lir_max) {
+        s->lir[f] = LIRS_LIR;           // still warming up
+        s->lir_count++;
+    } else {
+        link_push_front(&s->q, LIRS_Q, f);
+    }
+}
+
+// --- Shared building block: packed reference bits and clock ticks ---
+// Aging, NFU and WSClock model what a kernel can actually see: one R
+// bit per frame, set by "hardware" on every reference and only looked at
+// when the clock ticks (every tick_refs references) or a page must go.
+// All of their per-frame state is kept bit-sliced: bit f of word f/64,
+// one 64-bit word per 64 frames. A tick then updates 64 frames with one
+// word operation, and picking a victim narrows a candidate set one bit
+// position at a time instead of comparing counters frame by frame.
+
+// References between two clock ticks; 0 = one tick per 'frames'
+// references. Set once from -t before any simulation starts.
+static int64_t tick_refs = 0;
+
+struct RefBits {
+    int       frames;
+    int       words;        // (frames + 63) / 64
+    uint64_t  tail;         // bits of the last word that are real frames
+    uint64_t *r;            // R bits, cleared at every tick
+    uint64_t *cand;         // victim candidates while searching
+    uint64_t *spare;        // next candidate set, swapped with cand
+    int64_t   tick;         // references per tick
+    int64_t   next_tick;    // reference index of the next tick
+    int       hand;         // where the next victim search starts
+};
+
+static uint64_t *xcalloc_words(size_t count) {
+    uint64_t *p = calloc(count ? count : 1, sizeof(uint64_t));
+    if (p == NULL) die("out of memory");
+    return p;
+}
+
+static void refbits_init(struct RefBits *rb, int frames) {
+    rb->frames = frames;
+    rb->words = (frames + 63) / 64;
+    rb->tail = (frames % 64) ? (1ull << (frames % 64)) - 1 : ~0ull;
+    rb->r = xcalloc_words(rb->words);
+    rb->cand = xcalloc_words(rb->words);
+    rb->spare = xcalloc_words(rb->words);
+    rb->tick = tick_refs > 0 ? tick_refs : frames;
+    rb->next_tick = rb->tick;
+    rb->hand = 0;
+}
+
+static void refbits_free(struct RefBits *rb) {
+    free(rb->r);
+    free(rb->cand);
+    free(rb->spare);
+}
+
+static inline void bit_set(uint64_t *bits, int f)   { bits[f >> 6] |= 1ull << (f & 63); }
+static inline void bit_clear(uint64_t *bits, int f) { bits[f >> 6] &= ~(1ull << (f & 63)); }
+
+// Start a victim search with every frame as a candidate
+static void cand_all(struct RefBits *rb) {
+    for (int w = 0; w < rb->words; w++) rb->cand[w] = ~0ull;
+    rb->cand[rb->words - 1] = rb->tail;
+}
+
+// Drop the candidates whose bit is set in 'bits' - unless that would
+// drop all of them, in which case they were all equal on this bit
+static void cand_prefer_clear(struct RefBits *rb, const uint64_t *bits, size_t stride) {
+    uint64_t any = 0;
+    for (int w = 0; w < rb->words; w++) {
+        uint64_t c = rb->cand[w] & ~bits[w * stride];
+        rb->spare[w] = c;
+        any |= c;
+    }
+    if (!any) return;
+    uint64_t *old = rb->cand;
+    rb->cand = rb->spare;
+    rb->spare = old;
+}
+
+// First candidate at or after the hand (going round), then move the hand
+// past it, so ties are broken in clock order rather than by frame number
+static int cand_take(struct RefBits *rb) {
+    int w = rb->hand >> 6;
+    uint64_t m = rb->cand[w] & (~0ull << (rb->hand & 63));
+    for (int k = 0; k <= rb->words; k++) {
+        if (m) {
+            int f = w * 64 + __builtin_ctzll(m);
+            rb->hand = f + 1 == rb->frames ? 0 : f + 1;
+            return f;
+        }
+        if (++w == rb->words) w = 0;
+        m = rb->cand[w];
+    }
+    return -1;
+}
+
+// --- Aging ---
+// Each frame has an AGING_BITS-wide counter; at every tick all counters
+// shift right and the R bit enters at the top, so the counter is the
+// reference history of the last AGING_BITS ticks, newest first. The
+// victim is the frame with the smallest counter, with R (this tick so
+// far) counted above all of them.
+//
+// The counters are stored as AGING_BITS bit planes in a ring. Plane
+// head holds the newest bit, so a tick does not shift anything: the
+// oldest plane is overwritten with R and becomes the new head.
+//
+// WSClock below uses the same history; 'ws' and 'ws_tick' are its own.
+#define AGING_BITS   8
+#define WSCLOCK_TAU  4     // working-set window, in ticks (<= AGING_BITS)
+
+struct AgingPolicy {
+    struct RefBits rb;
+    uint64_t *plane;        // AGING_BITS planes of rb.words words
+    int       head;         // plane holding the newest history bit
+    int64_t   ticks;
+    uint64_t *ws;           // WSClock: OR of the newest WSCLOCK_TAU planes
+    int64_t   ws_tick;      // tick at which ws was computed (-1 = never)
+};
+
+static void *aging_create(const struct FrameTable *ft, const struct Trace *t) {
+    (void)t;
+    struct AgingPolicy *s = xmalloc(sizeof(*s));
+    refbits_init(&s->rb, ft->frames);
+    s->plane = xcalloc_words((size_t)AGING_BITS * s->rb.words);
+    s->head = 0;
+    s->ticks = 0;
+    s->ws = xcalloc_words(s->rb.words);
+    s->ws_tick = -1;
+    return s;
+}
+
+static void aging_destroy(void *p) {
+    struct AgingPolicy *s = p;
+    refbits_free(&s->rb);
+    free(s->plane);
+    free(s->ws);
+    free(s);
+}
+
+static inline uint64_t *aging_plane(struct AgingPolicy *s, int b) {
+    return s->plane + (size_t)((s->head + b) % AGING_BITS) * s->rb.words;
+}
+
+// Apply every tick that falls at or before reference i
+static inline void aging_tick(struct AgingPolicy *s, int64_t i) {
+    while (i >= s->rb.next_tick) {
+        s->head = s->head ? s->head - 1 : AGING_BITS - 1;
+        memcpy(aging_plane(s, 0), s->rb.r, s->rb.words * sizeof(uint64_t));
+        memset(s->rb.r, 0, s->rb.words * sizeof(uint64_t));
+        s->rb.next_tick += s->rb.tick;
+        s->ticks++;
+    }
+}
+
+static void aging_hit(void *p, int f, int64_t i) {
+    struct AgingPolicy *s = p;
+    aging_tick(s, i);
+    bit_set(s->rb.r, f);
+}
+
+static int aging_pick(struct AgingPolicy *s) {
+    cand_all(&s->rb);
+    cand_prefer_clear(&s->rb, s->rb.r, 1);
+    for (int b = 0; b < AGING_BITS; b++) cand_prefer_clear(&s->rb, aging_plane(s, b), 1);
+    return cand_take(&s->rb);
+}
+
+static int aging_evict(void *p, page_t page, int64_t i) {
+    (void)page;
+    struct AgingPolicy *s = p;
+    aging_tick(s, i);
+    return aging_pick(s);
+}
+
+// A new page starts with an empty history and its R bit set
+static void aging_insert(void *p, int f, page_t page, int64_t i) {
+    (void)page;
+    struct AgingPolicy *s = p;
+    aging_tick(s, i);
+    for (int b = 0; b < AGING_BITS; b++) bit_clear(s->plane + (size_t)b * s->rb.words, f);
+    bit_set(s->rb.r, f);
+}
+
+// --- WSClock (Carr & Hennessy) ---
+// A page is in the working set if it was referenced during the last
+// WSCLOCK_TAU ticks. The hand goes round the frames and takes the first
+// page outside the working set. Instead of a time of last use per frame
+// we read the aging history: the working set is R | the newest
+// WSCLOCK_TAU planes, so skipping referenced pages is a word-wide
+// find-first-set. (The trace has no writes, so every page is clean.)
+// If every page is in the working set, the oldest one by the aging
+// counter goes.
+static int wsclock_evict(void *p, page_t page, int64_t i) {
+    (void)page;
+    struct AgingPolicy *s = p;
+    struct RefBits *rb = &s->rb;
+    aging_tick(s, i);
+
+    if (s->ws_tick != s->ticks) {
+        memset(s->ws, 0, rb->words * sizeof(uint64_t));
+        for (int b = 0; b < WSCLOCK_TAU; b++) {
+            const uint64_t *plane = aging_plane(s, b);
+            for (int w = 0; w < rb->words; w++) s->ws[w] |= plane[w];
+        }
+        s->ws_tick = s->ticks;
+    }
+    for (int w = 0; w < rb->words; w++) rb->cand[w] = ~(s->ws[w] | rb->r[w]);
+    rb->cand[rb->words - 1] &= rb->tail;
+
+    int victim = cand_take(rb);
+    return victim >= 0 ? victim : aging_pick(s);
+}
+
+// --- NFU (not frequently used) ---
+// Each frame has a counter to which R is added at every tick; the victim
+// has the smallest count. Counters are NFU_BITS bit planes stored word
+// by word (all planes of word w together), and a tick is a bit-sliced
+// ripple-carry add of R into 64 counters at once. Counters saturate.
+#define NFU_BITS 32
+
+struct NfuPolicy {
+    struct RefBits rb;
+    uint64_t *count;        // count[w * NFU_BITS + b] = bit b of frames in word w
+    int       top;          // no counter has a bit set above this plane
+};
+
+static void *nfu_create(const struct FrameTable *ft, const struct Trace *t) {
+    (void)t;
+    struct NfuPolicy *s = xmalloc(sizeof(*s));
+    refbits_init(&s->rb, ft->frames);
+    s->count = xcalloc_words((size_t)NFU_BITS * s->rb.words);
+    s->top = 0;
+    return s;
+}
+
+static void nfu_destroy(void *p) {
+    struct NfuPolicy *s = p;
+    refbits_free(&s->rb);
+    free(s->count);
+    free(s);
+}
+
+static inline void nfu_tick(struct NfuPolicy *s, int64_t i) {
+    while (i >= s->rb.next_tick) {
+        for (int w = 0; w < s->rb.words; w++) {
+            uint64_t *c = s->count + (size_t)w * NFU_BITS;
+            uint64_t carry = s->rb.r[w];
+            int b = 0;
+            for (; b < NFU_BITS && carry; b++) {
+                uint64_t next = c[b] & carry;
+                c[b] ^= carry;
+                carry = next;
+            }
+            if (b - 1 > s->top) s->top = b - 1;
+            // Counters that overflowed stay at the maximum
+            if (carry) {
+                for (int b = 0; b < NFU_BITS; b++) c[b] |= carry;
+            }
+            s->rb.r[w] = 0;
+        }
+        s->rb.next_tick += s->rb.tick;
+    }
+}
+
+static void nfu_hit(void *p, int f, int64_t i) {
+    struct NfuPolicy *s = p;
+    nfu_tick(s, i);
+    bit_set(s->rb.r, f);
+}
+
+// Smallest count first (top bit down); R only breaks ties. Counts grow
+// by at most one per tick, so the planes above 'top' are all zero and
+// are skipped.
+static int nfu_evict(void *p, page_t page, int64_t i) {
+    (void)page;
+    struct NfuPolicy *s = p;
+    nfu_tick(s, i);
+    cand_all(&s->rb);
+    for (int b = s->top; b >= 0; b--) cand_prefer_clear(&s->rb, s->count + b, NFU_BITS);
+    cand_prefer_clear(&s->rb, s->rb.r, 1);
+    return cand_take(&s->rb);
+}
+
+static void nfu_insert(void *p, int f, page_t page, int64_t i) {
+    (void)page;
+    struct NfuPolicy *s = p;
+    nfu_tick(s, i);
+    uint64_t *c = s->count + (size_t)(f >> 6) * NFU_BITS;
+    for (int b = 0; b < NFU_BITS; b++) c[b] &= ~(1ull << (f & 63));
+    bit_set(s->rb.r, f);
+}
+
+static const struct PolicyOps policies[] = {
+    { "lru",      lru_create,      lru_destroy,      lru_hit,      lru_evict,      lru_insert,      0 },
+    { "opt",      opt_create,      opt_destroy,      opt_hit,      opt_evict,      opt_insert,      0 },
+    { "clock",    clock_create,    clock_destroy,    clock_hit,    clock_evict,    clock_insert,    0 },
+    { "clockpro", clockpro_create, clockpro_destroy, clockpro_hit, clockpro_evict, clockpro_insert, 0 },
+    { "arc",      arc_create,      arc_destroy,      arc_hit,      arc_evict,      arc_insert,      0 },
+    { "2q",       twoq_create,     twoq_destroy,     twoq_hit,     twoq_evict,     twoq_insert,     0 },
+    { "lirs",     lirs_create,     lirs_destroy,     lirs_hit,     lirs_evict,     lirs_insert,     0 },
+    { "aging",    aging_create,    aging_destroy,    aging_hit,    aging_evict,    aging_insert,    1 },
+    { "nfu",      nfu_create,      nfu_destroy,      nfu_hit,      nfu_evict,      nfu_insert,      1 },
+    { "wsclock",  aging_create,    aging_destroy,    aging_hit,    wsclock_evict,  aging_insert,    1 },
+};
+#define NUM_POLICIES ((int)(sizeof(policies) / sizeof(policies[0])))
+
+static const struct PolicyOps *find_policy(const char *name) {
+    for (int k = 0; k < NUM_POLICIES; k++) {
+        if (strcmp(policies[k].name, name) == 0) return &policies[k];
+    }
+    return NULL;
+}
+
+// Turn "arc,lirs" (or "all") into policies, in the order given.
+// Returns how many were stored in todo[] (at most NUM_POLICIES).
+static int parse_policies(const char *list, const struct PolicyOps *todo[]) {
+    int count = 0;
+    if (strcmp(list, "all") == 0) {
+        for (int k = 0; k < NUM_POLICIES; k++) todo[count++] = &policies[k];
+        return count;
+    }
+
+    char *names = strdup(list);
+    if (names == NULL) die("out of memory");
+    char *save = NULL;
+    for (char *name = strtok_r(names, ",", &save); name != NULL; name = strtok_r(NULL, ",", &save)) {
+        const struct PolicyOps *ops = find_policy(name);
+        if (ops == NULL) {
+            fprintf(stderr, "pagesim: unknown policy '%s'\n", name);
+            exit(2);
+        }
+        if (count < NUM_POLICIES) todo[count++] = ops;
+    }
+    free(names);
+    return count;
+}
+
+// 'pagesim run': every policy in the comma-separated list (or "all") on
+// the same trace and frame count, with its cost per reference
+static int run_main(const struct Trace *t, const char *list, int frames, int check) {
+    int64_t n = t->count;
+    page_t *pages = check ? trace_load_all(t) : NULL;
+    int status = 0;
+
+    printf("Frames: %d   References: %lld\n", frames, (long long)n);
+    printf("%-12s%-16s%-14s%s\n", "Policy", "Page Faults", "Miss Ratio", "ns/ref");
+    printf("------------------------------------------------------\n");
+
+    const struct PolicyOps *todo[NUM_POLICIES];
+    int count = parse_policies(list, todo);
+
+    for (int k = 0; k < count; k++) {
+        double start = now_sec();
+        int64_t faults = run_policy(todo[k], t, frames);
+        double elapsed = now_sec() - start;
+        printf("%-12s%-16lld%-14.6f%.1f\n", todo[k]->name, (long long)faults,
+               n ? (double)faults / n : 0.0, n ? elapsed * 1e9 / n : 0.0);
+
+        // LRU and OPT have textbook versions to check against
+        int64_t expected = -1;
+        if (check && strcmp(todo[k]->name, "lru") == 0) expected = run_lru_textbook(pages, n, frames);
+        if (check && strcmp(todo[k]->name, "opt") == 0) expected = run_opt_textbook(pages, n, frames);
+        if (expected >= 0) {
+            printf("  textbook %s: %lld (%s)\n", todo[k]->name, (long long)expected,
+                   expected == faults ? "match" : "MISMATCH");
+            if (expected != faults) status = 1;
+        }
+    }
+    printf("------------------------------------------------------\n");
+
+    free(pages);
+    return status;
+}
+
+// ----------------------------------------------------------------
+// 5. Sweep: every policy x frame count, in parallel
+// ----------------------------------------------------------------
+
+// Each (policy, frame count) pair is one job. Worker threads take the
+// next job from a shared counter until none are left; every job opens
+// its own TraceCursor on the one shared (mmapped, read-only) trace, so
+// the workers share nothing they write to except their result slot.
+// OPT's next-use array is built once up front and shared the same way.
+
+struct SweepJob {
+    const struct PolicyOps *ops;
+    int      frames;
+    int64_t  faults;
+    double   seconds;
+};
+
+struct Sweep {
+    const struct Trace *t;
+    struct SweepJob *jobs;
+    struct SweepJob **order;   // the jobs, costliest first
+    int      count;
+    int      next;             // next job to hand out
+    pthread_mutex_t lock;      // protects 'next'
+};
+
+static void *sweep_worker(void *param) {
+    struct Sweep *sw = param;
+    for (;;) {
+        pthread_mutex_lock(&sw->lock);
+        int k = sw->next++;
+        pthread_mutex_unlock(&sw->lock);
+        if (k >= sw->count) return NULL;
+
+        struct SweepJob *job = sw->order[k];
+        double start = thread_cpu_sec();
+        job->faults = run_policy(job->ops, sw->t, job->frames);
+        job->seconds = thread_cpu_sec() - start;
+    }
+}
+
+// Rough cost of a job per reference, in units of one O(1) policy step.
+// A tick-based policy scans F/64 words per counter bit on each fault;
+// on a Zipf trace that comes to about one O(1) step per 1024 frames.
+static int64_t sweep_cost(const struct SweepJob *job) {
+    return 1 + (job->ops->ticks ? job->frames / 1024 : 0);
+}
+
+// Costliest first; then more frames first (bigger maps and heaps), then
+// the order the user gave
+static int compare_sweep_jobs(const void *a, const void *b) {
+    const struct SweepJob *x = *(struct SweepJob *const *)a, *y = *(struct SweepJob *const *)b;
+    int64_t cx = sweep_cost(x), cy = sweep_cost(y);
+    if (cx != cy) return cx > cy ? -1 : 1;
+    if (x->frames != y->frames) return x->frames > y->frames ? -1 : 1;
+    return x < y ? -1 : x > y;
+}
+
+// Parse "64,128,1024" into frame counts; returns how many
+static int parse_frame_list(const char *list, int **out) {
+    int count = 1;
+    for (const char *c = list; *c; c++) count += *c == ',';
+    int *frames = xmalloc(count * sizeof(int));
+
+    count = 0;
+    for (const char *c = list; *c; ) {
+        char *end;
+        long f = strtol(c, &end, 10);
+        if (end == c || f < 1 || f > INT32_MAX) die("bad frame count list");
+        frames[count++] = (int)f;
+        c = *end == ',' ? end + 1 : end;
+        if (*end != ',' && *end != '\0') die("bad frame count list");
+    }
+    *out = frames;
+    return count;
+}
+
+// 'pagesim sweep': run all combinations on 'threads' threads and print
+// page faults as a table, one row per frame count
+static int sweep_main(struct Trace *t, const char *policy_list, const char *frame_list, int threads) {
+    const struct PolicyOps *todo[NUM_POLICIES];
+    int npol = parse_policies(policy_list, todo);
+    int *frames;
+    int nfr = parse_frame_list(frame_list, &frames);
+
+    struct Sweep sw;
+    sw.t = t;
+    sw.count = npol * nfr;
+    sw.next = 0;
+    sw.jobs = xmalloc(sw.count * sizeof(struct SweepJob));
+    pthread_mutex_init(&sw.lock, NULL);
+
+    // Jobs are stored one policy after another, in -p and -f order, and
+    // handed out costliest first so no thread is left running one long
+    // job at the end
+    sw.order = xmalloc(sw.count * sizeof(struct SweepJob *));
+    for (int k = 0; k < sw.count; k++) {
+        sw.jobs[k].ops = todo[k / nfr];
+        sw.jobs[k].frames = frames[k % nfr];
+        sw.order[k] = &sw.jobs[k];
+    }
+    qsort(sw.order, sw.count, sizeof(struct SweepJob *), compare_sweep_jobs);
+    for (int p = 0; p < npol; p++) {
+        if (strcmp(todo[p]->name, "opt") == 0 && t->next_use == NULL) {
+            t->next_use = build_next_use(t, 0);
+        }
+    }
+    // Many cursors read the mapping at different places at once, so
+    // drop the sequential hint from trace_open() and prefetch it all
+    if (t->map != NULL) {
+        madvise(t->map, t->map_size, MADV_NORMAL);
+        madvise(t->map, t->map_size, MADV_WILLNEED);
+    }
+
+    if (threads < 1) threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (threads < 1) threads = 1;
+    if (threads > sw.count) threads = sw.count;
+
+    double start = now_sec();
+    pthread_t *tids = xmalloc(threads * sizeof(pthread_t));
+    for (int i = 0; i < threads; i++) {
+        if (pthread_create(&tids[i], NULL, sweep_worker, &sw) != 0) die("cannot create thread");
+    }
+    for (int i = 0; i < threads; i++) pthread_join(tids[i], NULL);
+    double elapsed = now_sec() - start;
+
+    // --- Results table: page faults, one column per policy ---
+    printf("Sweep: %d policies x %d frame counts on %d threads   References: %lld\n",
+           npol, nfr, threads, (long long)t->count);
+    printf("%-10s", "Frames");
+    for (int p = 0; p < npol; p++) printf("%14s", todo[p]->name);
+    printf("\n");
+    for (int f = 0; f < nfr; f++) {
+        printf("%-10d", frames[f]);
+        for (int p = 0; p < npol; p++) {
+            printf("%14lld", (long long)sw.jobs[p * nfr + f].faults);
+        }
+        printf("\n");
+    }
+
+    double cpu = 0;
+    printf("%-10s", "ns/ref");
+    for (int p = 0; p < npol; p++) {
+        double sum = 0;
+        for (int f = 0; f < nfr; f++) sum += sw.jobs[p * nfr + f].seconds;
+        cpu += sum;
+        printf("%14.1f", t->count ? sum * 1e9 / nfr / t->count : 0.0);
+    }
+    printf("\n");
+    printf("Wall time: %.3f s   CPU time: %.3f s   Speedup: %.2fx\n",
+           elapsed, cpu, elapsed > 0 ? cpu / elapsed : 0.0);
+
+    free(tids);
+    pthread_mutex_destroy(&sw.lock);
+    free(sw.jobs);
+    free(sw.order);
+    free(frames);
+    return 0;
+}
+
+// ----------------------------------------------------------------
+// 6. SHARDS: sampled miss-ratio curves for huge traces
+// ----------------------------------------------------------------
+
+// Spatially hashed sampling (Waldspurger et al.): a page is tracked only
+// if hash(page) falls below a threshold T, i.e. with rate R = T / P.
+// Because the decision depends on the page and not on time, a sampled
+// page keeps all its references, and a stack distance d measured among
+// the sampled pages stands for about d / R in the full trace. Each
+// sampled reference then counts for 1 / R references.
+//
+// With a page limit (-m) this is "fixed-size" SHARDS: once more than
+// that many sampled pages are tracked, the pages with the largest hash
+// are dropped and T is lowered to their hash, so memory stays bounded
+// however many distinct pages the trace has. Each reference keeps the
+// weight 1 / R of the rate it was sampled at: it stood for that many
+// references when it was seen, and lowering T later does not change
+// that.
+
+#define SHARDS_P  (1u << 24)        // hash values are taken mod P
+
+// splitmix64 finalizer: spreads page numbers evenly over 64 bits
+static inline uint64_t mix64(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ull;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebull;
+    x ^= x >> 31;
+    return x;
+}
+
+// --- Stack distances over a bounded set of pages ---
+// Same Fenwick idea as section 3, but over "time stamps" instead of
+// trace positions. When the stamps run out, the live pages are renumbered
+// 0..k-1 in order and the tree is rebuilt, so the tree only needs to be
+// a few times bigger than the number of tracked pages.
+struct DistTracker {
+    struct Fenwick f;
+    struct PageMap last;    // page -> time stamp of its last reference
+    int64_t now;
+};
+
+static void dt_init(struct DistTracker *dt, int64_t max_pages) {
+    fen_init(&dt->f, 4 * max_pages > 1024 ? 4 * max_pages : 1024);
+    pmap_init(&dt->last, max_pages > 16 ? max_pages : 16);
+    dt->now = 0;
+}
+
+static void dt_free(struct DistTracker *dt) {
+    free(dt->f.t);
+    pmap_free(&dt->last);
+}
+
+struct Stamp {
+    int64_t ts;
+    size_t  slot;           // where the page sits in dt->last
+};
+
+static int compare_stamps(const void *a, const void *b) {
+    int64_t x = ((const struct Stamp *)a)->ts, y = ((const struct Stamp *)b)->ts;
+    return (x > y) - (x < y);
+}
+
+static void dt_compact(struct DistTracker *dt) {
+    int64_t live = (int64_t)dt->last.count;
+    struct Stamp *stamps = xmalloc(live * sizeof(struct Stamp));
+    int64_t k = 0;
+    for (size_t i = 0; i <= dt->last.mask; i++) {
+        if (dt->last.keys[i] != NO_PAGE) {
+            stamps[k].ts = dt->last.vals[i];
+            stamps[k].slot = i;
+            k++;
+        }
+    }
+    qsort(stamps, live, sizeof(struct Stamp), compare_stamps);
+
+    free(dt->f.t);
+    fen_init(&dt->f, 4 * live > 1024 ? 4 * live : 1024);
+    for (k = 0; k < live; k++) {
+        dt->last.vals[stamps[k].slot] = k;
+        fen_add(&dt->f, k, 1);
+    }
+    dt->now = live;
+    free(stamps);
+}
+
+// Reference 'page'. Returns its stack distance, or 0 the first time.
+static int64_t dt_access(struct DistTracker *dt, page_t page) {
+    if (dt->now == dt->f.n) dt_compact(dt);
+
+    int64_t d = 0;
+    int64_t *prev = pmap_find(&dt->last, page);
+    if (prev != NULL) {
+        d = fen_prefix(&dt->f, dt->now) - fen_prefix(&dt->f, *prev + 1) + 1;
+        fen_add(&dt->f, *prev, -1);
+        *prev = dt->now;
+    } else {
+        pmap_put(&dt->last, page, dt->now);
+    }
+    fen_add(&dt->f, dt->now, 1);
+    dt->now++;
+    return d;
+}
+
+static void dt_remove(struct DistTracker *dt, page_t page) {
+    int64_t *prev = pmap_find(&dt->last, page);
+    if (prev == NULL) return;
+    fen_add(&dt->f, *prev, -1);
+    pmap_remove(&dt->last, page);
+}
+
+// --- Max-heap of tracked pages by hash (fixed-size mode) ---
+struct HashHeap {
+    uint32_t *hash;
+    page_t   *page;
+    int64_t   size;
+};
+
+static void hh_push(struct HashHeap *h, uint32_t hash, page_t page) {
+    int64_t i = h->size++;
+    while (i > 0 && h->hash[(i - 1) / 2] < hash) {
+        h->hash[i] = h->hash[(i - 1) / 2];
+        h->page[i] = h->page[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    h->hash[i] = hash;
+    h->page[i] = page;
+}
+
+static page_t hh_pop(struct HashHeap *h) {
+    page_t top = h->page[0];
+    uint32_t hash = h->hash[--h->size];
+    page_t page = h->page[h->size];
+    int64_t i = 0;
+    for (;;) {
+        int64_t child = 2 * i + 1;
+        if (child >= h->size) break;
+        if (child + 1 < h->size && h->hash[child + 1] > h->hash[child]) child++;
+        if (h->hash[child] <= hash) break;
+        h->hash[i] = h->hash[child];
+        h->page[i] = h->page[child];
+        i = child;
+    }
+    h->hash[i] = hash;
+    h->page[i] = page;
+    return top;
+}
+
+struct ShardsResult {
+    double  *weight;        // weight[d] for estimated distance d (last slot: beyond)
+    int64_t  max_d;         // distances above this all land in weight[max_d + 1]
+    double   cold;          // weight of first references
+    double   total;         // weight of all sampled references
+    int64_t  sampled;       // sampled references
+    int64_t  peak_pages;    // most pages tracked at once
+    double   final_rate;
+};
+
+static void shards_run(const struct Trace *t, double rate, int64_t max_pages,
+                       int64_t max_d, struct ShardsResult *r) {
+    uint32_t threshold = (uint32_t)(rate * SHARDS_P);
+    if (threshold < 1) threshold = 1;
+    if (threshold > SHARDS_P) threshold = SHARDS_P;
+
+    struct DistTracker dt;
+    dt_init(&dt, max_pages > 0 ? max_pages + 1 : 1024);
+    struct HashHeap heap = { NULL, NULL, 0 };
+    if (max_pages > 0) {
+        heap.hash = xmalloc((max_pages + 1) * sizeof(uint32_t));
+        heap.page = xmalloc((max_pages + 1) * sizeof(page_t));
+    }
+
+    r->max_d = max_d;
+    r->weight = calloc(max_d + 2, sizeof(double));
+    if (r->weight == NULL) die("out of memory");
+    r->cold = r->total = 0;
+    r->sampled = 0;
+    r->peak_pages = 0;
+
+    struct TraceCursor c;
+    cursor_open(&c, t);
+    const page_t *chunk;
+    int64_t got;
+    while ((got = cursor_next(&c, &chunk)) > 0) {
+        for (int64_t k = 0; k < got; k++) {
+            uint32_t hash = (uint32_t)(mix64(chunk[k]) & (SHARDS_P - 1));
+            if (hash >= threshold) continue;
+
+            double R = (double)threshold / SHARDS_P;
+            double w = 1.0 / R;
+            r->sampled++;
+            r->total += w;
+
+            int64_t d = dt_access(&dt, chunk[k]);
+            if (d == 0) {
+                r->cold += w;
+                if (max_pages > 0) hh_push(&heap, hash, chunk[k]);
+            } else {
+                int64_t est = (int64_t)(d / R + 0.5);
+                r->weight[est <= max_d ? est : max_d + 1] += w;
+            }
+
+            int64_t tracked = (int64_t)dt.last.count;
+            if (tracked > r->peak_pages) r->peak_pages = tracked;
+
+            // Too many pages: drop the largest hash value(s) and lower T
+            if (max_pages > 0 && tracked > max_pages) {
+                uint32_t top = heap.hash[0];
+                while (heap.size > 0 && heap.hash[0] == top) dt_remove(&dt, hh_pop(&heap));
+                threshold = top;
+            }
+        }
+    }
+    cursor_close(&c);
+
+    r->final_rate = (double)threshold / SHARDS_P;
+
+    // SHARDS_adj: the weights should add up to the trace length. When
+    // they do not, it is mostly because a few very hot pages happened to
+    // be sampled (or not), so the difference goes to the smallest
+    // distance - a hit at every size.
+    r->weight[0] += (double)t->count - r->total;
+    r->total = (double)t->count;
+
+    dt_free(&dt);
+    free(heap.hash);
+    free(heap.page);
+}
+
+// With -c and a page limit, the fixed-size curve is also checked against
+// an unlimited run at its final rate. That run samples the same pages the
+// fixed-size one ends up with, so their errors should be close; a mean
+// error more than this much worse means the weights of the pages dropped
+// along the way are off.
+#define SHARDS_CHECK_SLACK  0.05
+
+// Estimated miss ratio at each of the nfr frame counts:
+// miss(F) = (cold + weight of distances > F) / total
+static double *shards_curve(const struct ShardsResult *r, const int *frames, int nfr) {
+    int64_t max_d = r->max_d;
+    double *beyond = xmalloc((max_d + 2) * sizeof(double));
+    beyond[max_d + 1] = r->weight[max_d + 1];
+    for (int64_t d = max_d; d >= 0; d--) beyond[d] = beyond[d + 1] + r->weight[d];
+
+    double *est = xmalloc(nfr * sizeof(double));
+    for (int f = 0; f < nfr; f++) {
+        est[f] = r->total > 0 ? (r->cold + beyond[frames[f] + 1]) / r->total : 0.0;
+        if (est[f] > 1.0) est[f] = 1.0;
+        if (est[f] < 0.0) est[f] = 0.0;
+    }
+    free(beyond);
+    return est;
+}
+
+// 'pagesim shards': estimated miss ratio at each frame count, plus the
+// error against the exact curve with -c
+static int shards_main(const struct Trace *t, double rate, int64_t max_pages,
+                       const char *frame_list, int check) {
+    int *frames;
+    int nfr = parse_frame_list(frame_list, &frames);
+    int64_t max_d = 1;
+    for (int f = 0; f < nfr; f++) if (frames[f] > max_d) max_d = frames[f];
+
+    double start = now_sec();
+    struct ShardsResult r;
+    shards_run(t, rate, max_pages, max_d, &r);
+    double elapsed = now_sec() - start;
+    double *est = shards_curve(&r, frames, nfr);
+
+    struct StackHist exact;
+    int64_t *exact_faults = NULL;
+    if (check) {
+        stack_distances(t, &exact);
+        exact_faults = stack_hist_faults(&exact, max_d);
+    }
+
+    printf("Policy: LRU (SHARDS)   References: %lld   Sampled: %lld   Rate: %.6f -> %.6f\n",
+           (long long)t->count, (long long)r.sampled, rate, r.final_rate);
+    printf("Pages tracked (peak): %lld\n", (long long)r.peak_pages);
+    printf("%-12s%-16s%s\n", "Frames", "Miss Ratio", check ? "Exact         Error" : "");
+    printf("------------------------------------------------------\n");
+
+    double err_sum = 0, err_max = 0;
+    for (int f = 0; f < nfr; f++) {
+        int F = frames[f];
+        printf("%-12d%-16.6f", F, est[f]);
+        if (check) {
+            double real = t->count ? (double)exact_faults[F] / t->count : 0.0;
+            double err = est[f] > real ? est[f] - real : real - est[f];
+            err_sum += err;
+            if (err > err_max) err_max = err;
+            printf("%-14.6f%.6f", real, err);
+        }
+        printf("\n");
+    }
+    printf("------------------------------------------------------\n");
+    if (check) printf("Mean absolute error: %.6f   Max error: %.6f\n", err_sum / nfr, err_max);
+    printf("Time: %.3f s (%.1f ns/ref)\n", elapsed, t->count ? elapsed * 1e9 / t->count : 0.0);
+
+    int status = 0;
+    if (check && max_pages > 0) {
+        struct ShardsResult full;
+        shards_run(t, r.final_rate, 0, max_d, &full);
+        double *full_est = shards_curve(&full, frames, nfr);
+        double full_sum = 0;
+        for (int f = 0; f < nfr; f++) {
+            double real = t->count ? (double)exact_faults[frames[f]] / t->count : 0.0;
+            full_sum += full_est[f] > real ? full_est[f] - real : real - full_est[f];
+        }
+        int bad = err_sum / nfr > full_sum / nfr + SHARDS_CHECK_SLACK;
+        printf("Without -m at rate %.6f: mean absolute error %.6f (%s)\n", r.final_rate,
+               full_sum / nfr, bad ? "MISMATCH" : "match");
+        status = bad ? 1 : 0;
+        free(full_est);
+        free(full.weight);
+    }
+
+    if (check) {
+        free(exact_faults);
+        stack_hist_free(&exact);
+    }
+    free(est);
+    free(r.weight);
+    free(frames);
+    return status;
+}
+
+// ----------------------------------------------------------------
+// 7. Microbenchmark: frame lookup kernels
+// ----------------------------------------------------------------
+
+// 'pagesim bench-lookup': the same random lookups (half hits, half
+// misses) through every kernel and through the hash table, for several
+// resident-set sizes. Misses scan the whole array, hits half of it on
+// average, which is what a simulator sees.
+
+#define BENCH_QUERIES  4096
+#define BENCH_LOOKUPS  (1 << 22)
+
+static double bench_kernel(frame_find_fn fn, const page_t *frame, int n,
+                           const page_t *query, int64_t *sink) {
+    for (int q = 0; q < BENCH_QUERIES; q++) {
+        if (fn(frame, n, query[q]) != find_scalar(frame, n, query[q]))
+            die("lookup kernel disagrees with the scalar loop");
+    }
+
+    int64_t sum = 0;
+    double start = now_sec();
+    for (int r = 0; r < BENCH_LOOKUPS / BENCH_QUERIES; r++) {
+        for (int q = 0; q < BENCH_QUERIES; q++) sum += fn(frame, n, query[q]);
+    }
+    double elapsed = now_sec() - start;
+    *sink += sum;
+    return elapsed * 1e9 / BENCH_LOOKUPS;
+}
+
+static double bench_hash(struct PageMap *m, const page_t *query, int64_t *sink) {
+    int64_t sum = 0;
+    double start = now_sec();
+    for (int r = 0; r < BENCH_LOOKUPS / BENCH_QUERIES; r++) {
+        for (int q = 0; q < BENCH_QUERIES; q++) {
+            int64_t *slot = pmap_find(m, query[q]);
+            sum += slot ? *slot : -1;
+        }
+    }
+    double elapsed = now_sec() - start;
+    *sink += sum;
+    return elapsed * 1e9 / BENCH_LOOKUPS;
+}
+
+static int bench_lookup_main(void) {
+    static const int sizes[] = {16, 32, 64, 128, 256, 512, 1024, 4096};
+    int nsizes = sizeof(sizes) / sizeof(sizes[0]);
+    int max = sizes[nsizes - 1];
+
+    page_t *frame = xmalloc(max * sizeof(page_t));
+    page_t query[BENCH_QUERIES];
+    int64_t sink = 0;
+
+    int have_sse4 = 0, have_avx2 = 0;
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    have_sse4 = __builtin_cpu_supports("sse4.1");
+    have_avx2 = __builtin_cpu_supports("avx2");
+#endif
+
+    printf("Frame lookup, ns per lookup (50%% hits)\n");
+    printf("%-10s%12s%12s%12s%12s%14s\n", "Frames", "scalar", "sse4.1", "avx2", "hash", "best/scalar");
+    printf("------------------------------------------------------------------------\n");
+    for (int k = 0; k < nsizes; k++) {
+        int n = sizes[k];
+        struct PageMap m;
+        pmap_init(&m, n);
+        for (int j = 0; j < n; j++) {
+            frame[j] = mix64(j + 1) >> 8;
+            pmap_put(&m, frame[j], j);
+        }
+        uint64_t seed = 12345;
+        for (int q = 0; q < BENCH_QUERIES; q++) {
+            seed = mix64(seed);
+            query[q] = (q & 1) ? frame[seed % n] : (mix64(n + seed) >> 8) | 1ull << 60;
+        }
+
+        double scalar = bench_kernel(find_scalar, frame, n, query, &sink);
+        double best = scalar;
+        printf("%-10d%12.2f", n, scalar);
+#if defined(__x86_64__) || defined(__i386__)
+        if (have_sse4) {
+            double t = bench_kernel(find_sse4, frame, n, query, &sink);
+            if (t < best) best = t;
+            printf("%12.2f", t);
+        } else {
+            printf("%12s", "-");
+        }
+        if (have_avx2) {
+            double t = bench_kernel(find_avx2, frame, n, query, &sink);
+            if (t < best) best = t;
+            printf("%12.2f", t);
+        } else {
+            printf("%12s", "-");
+        }
+#else
+        printf("%12s%12s", "-", "-");
+#endif
+        printf("%12.2f%13.1fx\n", bench_hash(&m, query, &sink), scalar / best);
+        pmap_free(&m);
+    }
+    printf("------------------------------------------------------------------------\n");
+    printf("Kernel in use: %s   (checksum %lld)\n", frame_find_name, (long long)sink);
+
+    free(frame);
+    (void)have_sse4; (void)have_avx2;
+    return 0;
+}
+
+// ----------------------------------------------------------------
+// 8. Set-associative caches
+// ----------------------------------------------------------------
+
+// 'pagesim cache' replays the trace as byte addresses through a
+// hierarchy of set-associative caches, e.g.
+//
+//   -L 32k:8:64,1m:16:64:clock      (size:ways:line[:policy], L1 first)
+//
+// Inside a set, replacement is done by the building blocks of the
+// paging engines - lru_touch(), the NextUseHeap and clock_sweep() - with
+// the ways in the role of frames; a one-set cache gives exactly the
+// fault counts of 'pagesim run'.
+//
+// Levels are non-inclusive and read-only (traces have no writes): each
+// level sees the misses of the level above it. The trace goes through
+// the hierarchy a cursor chunk at a time - a chunk runs through L1, its
+// misses through L2 and so on - so the misses in flight never take
+// more than two chunk buffers, however long the trace.
+//
+// OPT needs the future of its own input. For L1 that is the trace; for
+// a lower level the levels above it are run once beforehand just to
+// build the next uses of their misses, then reset.
+//
+// All per-set state is kept structure-of-arrays: way w of set s is slot
+// s * ways + w in each array, so one set's tags are contiguous and the
+// hit test is frame_find() over them (SIMD for the usual 4-16 ways).
+// Addresses are handled a cursor chunk at a time: the set indices of
+// the whole batch are computed first, and the tag row a few accesses
+// ahead is prefetched while the current access is simulated.
+
+enum { WAY_LRU, WAY_OPT, WAY_CLOCK };
+static const char *const way_policy_names[] = { "lru", "opt", "clock" };
+
+#define CACHE_MAX_LEVELS  8
+#define CACHE_PREFETCH    8     // accesses to look ahead in a batch
+
+struct CacheLevel {
+    int64_t   size;         // bytes
+    int       ways;
+    int       line_shift;   // log2(line size)
+    int64_t   sets;         // a power of two
+    int       policy;       // WAY_*
+
+    page_t   *tag;          // line in each slot, NO_PAGE = empty
+    uint16_t *used;         // ways filled in each set
+
+    struct Links lru;       // LRU: one recency list per set
+    int64_t  *key;          // OPT: next use of each slot
+    int      *heap;         // OPT: one heap of ways per set
+    int      *hpos;         //      position of each slot in its heap
+    uint8_t  *ref;          // CLOCK: reference bit of each slot
+    int      *hand;         // CLOCK: hand of each set
+    int64_t  *next_use;     // OPT: next use of each access to this level
+
+    int64_t   accesses;
+    int64_t   misses;
+};
+
+// "32k", "1m", "64" -> bytes
+static int64_t parse_size(const char *s) {
+    char *end;
+    int64_t v = strtoll(s, &end, 10);
+    if (*end == 'k' || *end == 'K') v <<= 10;
+    else if (*end == 'm' || *end == 'M') v <<= 20;
+    else if (*end == 'g' || *end == 'G') v <<= 30;
+    return v;
+}
+
+// Parse "size:ways:line[:policy]" into lv (no arrays yet)
+static void cache_parse_level(struct CacheLevel *lv, char *spec) {
+    memset(lv, 0, sizeof(*lv));
+    char *save = NULL;
+    char *size = strtok_r(spec, ":", &save);
+    char *ways = strtok_r(NULL, ":", &save);
+    char *line = strtok_r(NULL, ":", &save);
+    char *policy = strtok_r(NULL, ":", &save);
+    if (size == NULL || ways == NULL || line == NULL) die("cache level must be size:ways:line[:policy]");
+
+    lv->size = parse_size(size);
+    lv->ways = atoi(ways);
+    int64_t line_size = parse_size(line);
+    if (line_size < 1 || (line_size & (line_size - 1))) die("cache line size must be a power of two");
+    if (lv->ways < 1 || lv->ways > UINT16_MAX) die("bad number of ways");
+    lv->line_shift = __builtin_ctzll(line_size);
+
+    lv->sets = lv->size / (line_size * lv->ways);
+    if (lv->sets < 1 || lv->sets * line_size * lv->ways != lv->size || (lv->sets & (lv->sets - 1)))
+        die("cache size must be ways * line size * a power of two");
+
+    lv->policy = WAY_LRU;
+    if (policy != NULL) {
+        int k = 0;
+        while (k < 3 && strcmp(way_policy_names[k], policy) != 0) k++;
+        if (k == 3) die("cache policy must be lru, opt or clock");
+        lv->policy = k;
+    }
+}
+
+static void cache_alloc(struct CacheLevel *lv) {
+    // Slots and list heads are int indices (struct Links, NextUseHeap)
+    int64_t slots;
+    if (__builtin_mul_overflow(lv->sets, (int64_t)lv->ways, &slots) || slots > INT32_MAX - lv->sets)
+        die("cache has too many lines");
+    lv->tag = xmalloc(slots * sizeof(page_t));
+    for (int64_t k = 0; k < slots; k++) lv->tag[k] = NO_PAGE;
+    lv->used = calloc(lv->sets, sizeof(uint16_t));
+    if (lv->used == NULL) die("out of memory");
+
+    if (lv->policy == WAY_LRU) {
+        links_init(&lv->lru, (int)slots, (int)lv->sets);
+    } else if (lv->policy == WAY_OPT) {
+        lv->key = xmalloc(slots * sizeof(int64_t));
+        lv->heap = xmalloc(slots * sizeof(int));
+        lv->hpos = xmalloc(slots * sizeof(int));
+        for (int64_t k = 0; k < slots; k++) lv->hpos[k] = -1;
+    } else {
+        lv->ref = calloc(slots, 1);
+        lv->hand = calloc(lv->sets, sizeof(int));
+        if (lv->ref == NULL || lv->hand == NULL) die("out of memory");
+    }
+}
+
+static void cache_free(struct CacheLevel *lv) {
+    free(lv->tag);
+    free(lv->used);
+    if (lv->policy == WAY_LRU) links_free(&lv->lru);
+    free(lv->key);
+    free(lv->heap);
+    free(lv->hpos);
+    free(lv->ref);
+    free(lv->hand);
+}
+
+// The OPT heap of the set whose slots start at 'row', holding 'size' ways
+static inline struct NextUseHeap cache_heap(struct CacheLevel *lv, size_t row, int size) {
+    struct NextUseHeap h = { lv->key + row, lv->heap + row, lv->hpos + row, size };
+    return h;
+}
+
+// Pick the way to replace in a full set whose slots start at 'row'
+static int cache_victim(struct CacheLevel *lv, int64_t set, size_t row) {
+    if (lv->policy == WAY_LRU) return (int)(link_back(&lv->lru, (int)set) - row);
+    if (lv->policy == WAY_OPT) return lv->heap[row];
+    return clock_sweep(lv->ref + row, lv->ways, &lv->hand[set]);
+}
+
+// Way w of the set was just used by access i, next used at 'next'
+static void cache_touch(struct CacheLevel *lv, int64_t set, size_t row, int w, int64_t next) {
+    if (lv->policy == WAY_LRU) {
+        lru_touch(&lv->lru, (int)set, (int)(row + w));
+    } else if (lv->policy == WAY_OPT) {
+        // A way filled just now is not in the heap yet
+        struct NextUseHeap h = cache_heap(lv, row, lv->used[set] - (lv->hpos[row + w] < 0));
+        nuheap_set(&h, w, next);
+    } else {
+        lv->ref[row + w] = 1;
+    }
+}
+
+// Run the next n addresses of this level's input through it. The misses
+// go to out[] as line addresses (at most n); returns how many.
+static int64_t cache_batch(struct CacheLevel *lv, const page_t *addr, int64_t n, page_t *out) {
+    page_t line[TRACE_CHUNK];
+    int64_t set[TRACE_CHUNK];
+    int64_t set_mask = lv->sets - 1;
+    int64_t missed = 0;
+    for (int64_t k = 0; k < n; k++) {
+        line[k] = addr[k] >> lv->line_shift;
+        set[k] = (int64_t)(line[k] & set_mask);
+    }
+
+    for (int64_t k = 0; k < n; k++) {
+        if (k + CACHE_PREFETCH < n) {
+            size_t ahead = (size_t)set[k + CACHE_PREFETCH] * lv->ways;
+            __builtin_prefetch(&lv->tag[ahead]);
+        }
+
+        int64_t s = set[k];
+        size_t row = (size_t)s * lv->ways;
+
+        int w = frame_find(&lv->tag[row], lv->used[s], line[k]);
+        if (w < 0) {
+            out[missed++] = line[k] << lv->line_shift;
+            w = lv->used[s] < lv->ways ? lv->used[s]++ : cache_victim(lv, s, row);
+            lv->tag[row + w] = line[k];
+        }
+        cache_touch(lv, s, row, w, lv->next_use ? lv->next_use[lv->accesses + k] : 0);
+    }
+    lv->accesses += n;
+    lv->misses += missed;
+    return missed;
+}
+
+// Run the whole trace through level[0..levels-1]. If 'below' is given,
+// the misses of the last of them are fed to it.
+static void cache_run(struct CacheLevel *level, int levels, const struct Trace *t,
+                      struct NextUseBuilder *below) {
+    page_t buf[2][TRACE_CHUNK];
+    struct TraceCursor c;
+    cursor_open(&c, t);
+    const page_t *chunk;
+    int64_t got;
+    while ((got = cursor_next(&c, &chunk)) > 0) {
+        const page_t *in = chunk;
+        int64_t n = got;
+        for (int l = 0; l < levels && n > 0; l++) {
+            n = cache_batch(&level[l], in, n, buf[l & 1]);
+            in = buf[l & 1];
+        }
+        if (below != NULL) {
+            for (int64_t k = 0; k < n; k++) nub_push(below, in[k]);
+        }
+    }
+    cursor_close(&c);
+}
+
+static int cache_main(const struct Trace *t, const char *spec) {
+    struct CacheLevel level[CACHE_MAX_LEVELS];
+    int levels = 0;
+
+    char *specs = strdup(spec);
+    if (specs == NULL) die("out of memory");
+    char *save = NULL;
+    for (char *one = strtok_r(specs, ",", &save); one != NULL; one = strtok_r(NULL, ",", &save)) {
+        if (levels == CACHE_MAX_LEVELS) die("too many cache levels");
+        cache_parse_level(&level[levels++], one);
+    }
+    free(specs);
+    if (levels == 0) die("no cache levels given");
+
+    double start = now_sec();
+    for (int l = 0; l < levels; l++) {
+        struct CacheLevel *lv = &level[l];
+        cache_alloc(lv);
+        if (lv->policy != WAY_OPT) continue;
+        if (l == 0) {
+            lv->next_use = build_next_use(t, lv->line_shift);
+            continue;
+        }
+
+        // A pass through the levels above to see what reaches this one
+        struct NextUseBuilder b;
+        nub_init(&b, lv->line_shift, 0);
+        cache_run(level, l, t, &b);
+        lv->next_use = nub_finish(&b);
+        for (int k = 0; k < l; k++) {
+            cache_free(&level[k]);
+            cache_alloc(&level[k]);
+            level[k].accesses = level[k].misses = 0;
+        }
+    }
+    cache_run(level, levels, t, NULL);
+    double elapsed = now_sec() - start;
+    int64_t memory = level[levels - 1].misses;
+
+    int64_t n = t->count;
+    printf("References: %lld\n", (long long)n);
+    printf("%-7s%-10s%-6s%-6s%-10s%-8s%-14s%-14s%s\n",
+           "Level", "Size", "Ways", "Line", "Sets", "Policy", "Accesses", "Misses", "Miss Ratio");
+    printf("-----------------------------------------------------------------------------------\n");
+    for (int l = 0; l < levels; l++) {
+        struct CacheLevel *lv = &level[l];
+        char size[32];
+        if (lv->size % (1 << 20) == 0) snprintf(size, sizeof(size), "%lldM", (long long)(lv->size >> 20));
+        else if (lv->size % (1 << 10) == 0) snprintf(size, sizeof(size), "%lldK", (long long)(lv->size >> 10));
+        else snprintf(size, sizeof(size), "%lld", (long long)lv->size);
+        printf("L%-6d%-10s%-6d%-6d%-10lld%-8s%-14lld%-14lld%.6f\n", l + 1, size, lv->ways,
+               1 << lv->line_shift, (long long)lv->sets, way_policy_names[lv->policy],
+               (long long)lv->accesses, (long long)lv->misses,
+               lv->accesses ? (double)lv->misses / lv->accesses : 0.0);
+        cache_free(lv);
+        free(lv->next_use);
+    }
+    printf("-----------------------------------------------------------------------------------\n");
+    printf("Memory accesses: %lld (%.4f per reference)\n", (long long)memory,
+           n ? (double)memory / n : 0.0);
+    printf("Time: %.3f s (%.1f ns/ref)\n", elapsed, n ? elapsed * 1e9 / n : 0.0);
+    return 0;
+}
+
+// ----------------------------------------------------------------
+// Main function to run everything
+// ----------------------------------------------------------------
+
+static void usage(void) {
+    fprintf(stderr, "usage: pagesim opt|lru|mrc [-f frames] [-c] [-s] [trace]\n"
+                    "       pagesim run [-p policy,...|all] [-f frames] [-t refs] [-c] [-s] [trace]\n"
+                    "       pagesim sweep [-p policy,...|all] [-f frames,...] [-t refs] [-j threads] [-s] [trace]\n"
+                    "       pagesim shards [-r rate] [-m max_pages] [-f frames,...] [-c] [-s] [trace]\n"
+                    "       pagesim cache [-L size:ways:line[:policy],...] [-s] [trace]\n"
+                    "       pagesim convert [-F raw32|raw64|delta] [-s] trace out\n"
+                    "       pagesim bench-lookup\n");
+    exit(2);
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) usage();
+    const char *mode = argv[1];
+    pick_frame_find();
+    if (strcmp(mode, "bench-lookup") == 0) return bench_lookup_main();
+
+    int frames = 0;
+    const char *frame_list = NULL;
+    int threads = 0;
+    int check = 0;
+    int stream = 0;
+    int format = TRACE_DELTA;
+    const char *policy_list = "all";
+    const char *cache_levels = "32k:8:64,1m:16:64";
+    double rate = 0.01;
+    int64_t max_pages = 8192;
+    int opt;
+    optind = 2;
+    while ((opt = getopt(argc, argv, "f:csF:p:j:r:m:t:L:")) != -1) {
+        switch (opt) {
+        case 'f': frames = atoi(optarg); frame_list = optarg; break;
+        case 'j': threads = atoi(optarg); break;
+        case 'r': rate = atof(optarg); break;
+        case 'm': max_pages = atoll(optarg); break;
+        case 't': tick_refs = atoll(optarg); break;
+        case 'c': check = 1; break;
+        case 's': stream = 1; break;
+        case 'p': policy_list = optarg; break;
+        case 'L': cache_levels = optarg; break;
+        case 'F':
+            if (strcmp(optarg, "raw32") == 0) format = TRACE_RAW32;
+            else if (strcmp(optarg, "raw64") == 0) format = TRACE_RAW64;
+            else if (strcmp(optarg, "delta") == 0) format = TRACE_DELTA;
+            else usage();
+            break;
+        default:  usage();
+        }
+    }
+    if (frames < 0) die("need at least one frame");
+
+    // Open the reference string
+    struct Trace trace;
+    if (optind < argc) {
+        trace_open(&trace, argv[optind], stream);
+    } else {
+        trace_from_memory(&trace, default_pages, sizeof(default_pages) / sizeof(default_pages[0]));
+    }
+    int64_t n = trace.count;
+    int status = 0;
+
+    if (strcmp(mode, "convert") == 0) {
+        if (optind + 2 != argc) usage();
+        status = convert_main(&trace, format, argv[optind + 1]);
+        trace_close(&trace);
+        return status;
+    }
+    if (strcmp(mode, "mrc") == 0) {
+        status = mrc_main(&trace, frames, check);
+        trace_close(&trace);
+        return status;
+    }
+    if (strcmp(mode, "cache") == 0) {
+        status = cache_main(&trace, cache_levels);
+        trace_close(&trace);
+        return status;
+    }
+    if (strcmp(mode, "sweep") == 0) {
+        status = sweep_main(&trace, policy_list, frame_list ? frame_list : "3", threads);
+        trace_close(&trace);
+        return status;
+    }
+    if (strcmp(mode, "shards") == 0) {
+        if (rate <= 0 || rate > 1) die("sampling rate must be in (0, 1]");
+        status = shards_main(&trace, rate, max_pages,
+                             frame_list ? frame_list : "1,4,16,64,256,1024,4096,16384,65536", check);
+        trace_close(&trace);
+        return status;
+    }
+    if (frames == 0) frames = 3;
+    if (strcmp(mode, "run") == 0) {
+        status = run_main(&trace, policy_list, frames, check);
+        trace_close(&trace);
+        return status;
+    }
+
+    // Pick the fast engine and its textbook twin
+    int64_t (*run)(const struct Trace *, int) = NULL;
+    int64_t (*textbook)(const page_t *, int64_t, int) = NULL;
+    const char *name = NULL;
+    if (strcmp(mode, "opt") == 0) {
+        run = run_opt; textbook = run_opt_textbook; name = "OPT";
+    } else if (strcmp(mode, "lru") == 0) {
+        run = run_lru; textbook = run_lru_textbook; name = "LRU";
+    } else {
+        usage();
+    }
+
+    double start = now_sec();
+    int64_t faults = run(&trace, frames);
+    double elapsed = now_sec() - start;
+
+    printf("Policy: %s   Frames: %d   References: %lld\n", name, frames, (long long)n);
+    printf("Total Page Faults = %lld\n", (long long)faults);
+    printf("Time: %.3f s (%.1f ns/ref)\n", elapsed, n ? elapsed * 1e9 / n : 0.0);
+
+    if (check) {
+        page_t *pages = trace_load_all(&trace);
+        int64_t expected = textbook(pages, n, frames);
+        printf("Textbook %s Page Faults = %lld (%s)\n", name, (long long)expected,
+               expected == faults ? "match" : "MISMATCH");
+        if (expected != faults) status = 1;
+        free(pages);
+    }
+
+    trace_close(&trace);
+    return status;
+}
+
+
 // -----------------------------------------------------
 // FCFS
 